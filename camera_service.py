@@ -1,15 +1,56 @@
 import cv2
+import os
+import mmap
 import socket
 import json
 import time
 import struct
+import zlib
+import queue
+import signal
+import threading
+import multiprocessing as mp
+from collections import deque
 from datetime import datetime
 
 # --- CONFIG ---
 CAMERA_ID = 0
+# Comma-separated NAME=SOURCE pairs; a source is a V4L2 index, a /dev/video* path or a video file
+CAMERAS = os.environ.get("CAMERAS", f"CAM0={CAMERA_ID}")
+CAMERA_MUX = os.environ.get("CAMERA_MUX", "0") == "1"          # one shared connection instead of one per camera
+CAMERA_PIN_CORES = os.environ.get("CAMERA_PIN_CORES", "1") == "1"
+MUX_QUEUE_MAX = 32     # frames waiting for the shared connection (newest dropped when full)
+STATS_INTERVAL = 10    # seconds between supervisor stats reports
+RESTART_DELAY = 3      # seconds before a crashed camera process is restarted
 CAPTURE_INTERVAL = 0.3  
+ENCODE_QUEUE_MAX = 4   # captured frames waiting for encode (oldest dropped when full)
+SEND_QUEUE_MAX = 8     # encoded frames waiting for send (oldest dropped when full)
 NODE_HOST = "localhost"
 NODE_PORT = 9000
+TRANSPORT = os.environ.get("CAMERA_TRANSPORT", "tcp")  # "tcp" or "shm" (same host only)
+PIXEL_FORMAT = os.environ.get("CAMERA_FORMAT", "bmp")   # "bmp", or raw "bgr24" / "yuyv" (no encode pass)
+SHM_SOCKET_PATH = "/tmp/surveillance-shm.sock"
+
+# TCP ingest protocol (must match server/ingestProtocol.js)
+PROTOCOL_VERSION = 2
+BANNER_MAGIC = 0x53565056       # 'SVPV'
+FRAME_MAGIC_V2 = 0x53564632     # 'SVF2'
+V2_HEADER = struct.Struct("!IBBH8sQII")
+V2_CAMNO_MAX = 8                # bytes; NUL padded, never truncated
+CODEC_BMP = 0
+CODEC_BGR24 = 1
+CODEC_YUYV = 2
+CODECS = {"bmp": CODEC_BMP, "bgr24": CODEC_BGR24, "yuyv": CODEC_YUYV}
+CODEC_NAMES = {codec: name for name, codec in CODECS.items()}
+RAW_EXTENSION = struct.Struct("!HHI")
+
+# Shared-memory ring layout (must match server/native/shm_ring.cc)
+RING_MAGIC = 0x474E5253
+RING_VERSION = 2
+RING_CTRL_SIZE = 128
+SLOT_HDR_SIZE = 96
+SLOT_FREE = 0
+SLOT_READY = 1
 
 def log(message, level="INFO"):
     timestamp = datetime.now().strftime("%H:%M:%S.%f")[:-3]
@@ -22,20 +63,74 @@ def get_frame_name():
     now = datetime.now()
     return now.strftime("%y%m%d%H%M%S_%f") + ".bmp"
 
-def send_frame_data(sock, cam_no, frame_bytes, timestamp, filename):
+def negotiate_protocol(sock, timeout=1.0):
+    """Read the server banner and pick the highest common protocol version.
+
+    Servers that predate the banner never send one, so fall back to v1.
+    """
+    sock.settimeout(timeout)
+    banner = b""
     try:
+        while len(banner) < 6:
+            chunk = sock.recv(6 - len(banner))
+            if not chunk:
+                break
+            banner += chunk
+    except socket.timeout:
+        pass
+    finally:
+        sock.settimeout(None)
+
+    if len(banner) < 6:
+        return 1
+    magic, _min_version, max_version = struct.unpack("!IBB", banner)
+    if magic != BANNER_MAGIC:
+        return 1
+    return min(PROTOCOL_VERSION, max_version)
+
+def pack_header_v2(cam_no, timestamp, size, fmt=None):
+    """fmt is None for BMP, or (codec, width, height, stride) for raw pixels."""
+    cam_bytes = cam_no.encode()
+    if len(cam_bytes) > V2_CAMNO_MAX:
+        raise ValueError(f"camera name {cam_no!r} is longer than {V2_CAMNO_MAX} bytes")
+    codec = fmt[0] if fmt else CODEC_BMP
+    extension = RAW_EXTENSION.pack(*fmt[1:]) if fmt else b""
+    header = V2_HEADER.pack(FRAME_MAGIC_V2, 2, codec, V2_HEADER.size + len(extension),
+                            cam_bytes, timestamp, size, 0)
+    crc = zlib.crc32(header[:28] + extension)
+    return header[:28] + struct.pack("!I", crc) + extension
+
+def sendmsg_all(sock, buffers):
+    """Send several buffers as one scatter-gather write, finishing any partial send."""
+    views = [memoryview(b).cast("B") for b in buffers]
+    while views:
+        sent = sock.sendmsg(views)
+        while sent:
+            if sent >= len(views[0]):
+                sent -= len(views[0])
+                views.pop(0)
+            else:
+                views[0] = views[0][sent:]
+                sent = 0
+
+def send_frame_data(sock, cam_no, frame_bytes, timestamp, filename, version=1, fmt=None):
+    try:
+        if version >= 2:
+            sendmsg_all(sock, [pack_header_v2(cam_no, timestamp, len(frame_bytes), fmt), frame_bytes])
+            return True
+
         metadata = {
             "camNo": cam_no,
             "timestamp": timestamp,
             "filename": filename,
             "size": len(frame_bytes)
         }
+        if fmt:
+            metadata.update(format=CODEC_NAMES[fmt[0]], width=fmt[1], height=fmt[2], stride=fmt[3])
         metadata_json = json.dumps(metadata).encode('utf-8')
         metadata_length = struct.pack('!I', len(metadata_json))
 
-        sock.sendall(metadata_length)
-        sock.sendall(metadata_json)
-        sock.sendall(frame_bytes)
+        sendmsg_all(sock, [metadata_length, metadata_json, frame_bytes])
         return True
 
     except (BrokenPipeError, ConnectionResetError):
@@ -44,103 +139,542 @@ def send_frame_data(sock, cam_no, frame_bytes, timestamp, filename):
         log(f"Send error: {e}", "ERROR")
         return False
 
-def main():
-    log("Camera capture service starting...")
+class ShmRingWriter:
+    """Producer side of the server's shared-memory frame ring.
 
-    cam = cv2.VideoCapture(CAMERA_ID)
-    if not cam.isOpened():
-        log("FATAL: Could not open camera!", "ERROR")
-        log("Check: ls -l /dev/video* to verify camera is connected", "ERROR")
-        return
+    The server hands over a memfd (the ring) and an eventfd (the doorbell) on
+    connect; after that each frame is written straight into a slot and the
+    doorbell is rung, without going through a socket. Frames larger than a
+    slot go over a side TCP connection instead; frames that find their slot
+    still busy are dropped and counted in `dropped`.
+    """
 
-    cam.set(cv2.CAP_PROP_BUFFERSIZE, 1)
-    width = int(cam.get(cv2.CAP_PROP_FRAME_WIDTH))
-    height = int(cam.get(cv2.CAP_PROP_FRAME_HEIGHT))
-    log(f"Camera opened: {width}x{height}")
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        msg, fds, _, _ = socket.recv_fds(self.sock, 16, 2)
+        if len(msg) != 16 or len(fds) != 2:
+            self.sock.close()
+            raise ConnectionError("Malformed ring handshake")
 
-    # Connect to Node.js
-    log(f"Connecting to Node.js at {NODE_HOST}:{NODE_PORT}...")
-    sock = None
-    while sock is None:
+        magic, version, self.slot_count, self.slot_size = struct.unpack("<4I", msg)
+        if magic != RING_MAGIC or version != RING_VERSION:
+            self.sock.close()
+            raise ConnectionError(f"Unsupported ring (magic {magic:#x}, version {version})")
+
+        self.memfd, self.eventfd = fds
+        size = RING_CTRL_SIZE + self.slot_count * (SLOT_HDR_SIZE + self.slot_size)
+        self.mem = mmap.mmap(self.memfd, size)
+        self.head = 0
+        self.dropped = 0
+        self.tcp = None  # (socket, protocol version) for oversized frames, opened on first use
+        self.tcp_retry_at = 0.0
+
+    def alive(self):
         try:
-            sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-            sock.connect((NODE_HOST, NODE_PORT))
-            log("Connected to Node.js server")
-            break
-        except ConnectionRefusedError:
+            return self.sock.recv(1, socket.MSG_PEEK | socket.MSG_DONTWAIT) != b""
+        except BlockingIOError:
+            return True
+        except OSError:
+            return False
+
+    def send(self, cam_no, frame_bytes, timestamp, filename, fmt=None):
+        if not self.alive():
+            return False
+
+        size = len(frame_bytes)
+        if size > self.slot_size:
+            self.send_oversized(cam_no, frame_bytes, timestamp, filename, fmt)
+            return True
+
+        slot = self.head % self.slot_count
+        offset = RING_CTRL_SIZE + slot * (SLOT_HDR_SIZE + self.slot_size)
+        if struct.unpack_from("<I", self.mem, offset)[0] != SLOT_FREE:
+            # Server still holds this slot; drop rather than overwrite it
+            self.dropped += 1
+            return True
+
+        data = offset + SLOT_HDR_SIZE
+        self.mem[data:data + size] = frame_bytes
+        struct.pack_into("<IQ16s32s4I", self.mem, offset + 4, size, timestamp,
+                         cam_no.encode(), filename.encode(), *(fmt or (CODEC_BMP, 0, 0, 0)))
+        # Publish the slot last so the consumer never sees a partial frame
+        struct.pack_into("<I", self.mem, offset, SLOT_READY)
+
+        self.head += 1
+        struct.pack_into("<Q", self.mem, 16, self.head)
+        os.eventfd_write(self.eventfd, 1)
+        return True
+
+    def send_oversized(self, cam_no, frame_bytes, timestamp, filename, fmt):
+        """Send a frame that does not fit a slot over TCP; a failure drops just that frame."""
+        if self.tcp is None:
+            if time.monotonic() < self.tcp_retry_at:
+                self.dropped += 1
+                return
+            try:
+                sock = socket.create_connection((NODE_HOST, NODE_PORT), timeout=2)
+                sock.settimeout(None)
+                self.tcp = (sock, negotiate_protocol(sock))
+                log(f"Frames over {self.slot_size} bytes go over TCP (protocol v{self.tcp[1]})", "WARN")
+            except OSError as e:
+                log(f"Oversized frame dropped, TCP fallback unavailable: {e}", "WARN")
+                self.tcp_retry_at = time.monotonic() + 5
+                self.dropped += 1
+                return
+
+        sock, version = self.tcp
+        if fmt and version == 1:
+            # v1 servers only take BMP, and the raw frame can't be re-encoded here
+            self.dropped += 1
+            return
+        if not send_frame_data(sock, cam_no, frame_bytes, timestamp, filename, version, fmt):
+            sock.close()
+            self.tcp = None
+            self.dropped += 1
+
+    def close(self):
+        if self.tcp:
+            self.tcp[0].close()
+        self.mem.close()
+        os.close(self.memfd)
+        os.close(self.eventfd)
+        self.sock.close()
+
+def connect_node():
+    """Connect to the Node.js server over the configured transport, retrying until it is up.
+
+    Returns (conn, protocol_version); the version only applies to TCP.
+    """
+    while True:
+        try:
+            if TRANSPORT == "shm":
+                conn = ShmRingWriter(SHM_SOCKET_PATH)
+                log(f"Attached to shared-memory ring ({conn.slot_count} x {conn.slot_size} bytes)")
+                return conn, None
+
+            conn = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            conn.connect((NODE_HOST, NODE_PORT))
+            version = negotiate_protocol(conn)
+            log(f"Connected to Node.js server (protocol v{version})")
+            return conn, version
+        except (ConnectionRefusedError, FileNotFoundError):
             log("Waiting for Node.js server...", "WARN")
             time.sleep(2)
+        except OSError as e:
+            log(f"Connect error: {e}", "WARN")
+            time.sleep(1)
 
-    log(f"Starting capture at {1/CAPTURE_INTERVAL:.1f} FPS")
+def send_frame(conn, version, cam_no, frame_bytes, timestamp, filename, fmt=None):
+    if isinstance(conn, ShmRingWriter):
+        return conn.send(cam_no, frame_bytes, timestamp, filename, fmt)
+    return send_frame_data(conn, cam_no, frame_bytes, timestamp, filename, version, fmt)
 
-    frame_count = 0
-    stats_capture = stats_encode = stats_send = 0
-    stats_start = time.time()
+def encode_bmp(frame, fmt=None):
+    """BMP-encode a captured frame, converting from YUYV when the camera delivers raw 4:2:2."""
+    if fmt and fmt[0] == CODEC_YUYV:
+        frame = cv2.cvtColor(frame.reshape(fmt[2], fmt[1], 2), cv2.COLOR_YUV2BGR_YUYV)
+    ret, bmp_buffer = cv2.imencode('.bmp', frame)
+    return memoryview(bmp_buffer).cast("B") if ret else None
 
-    try:
-        while True:
-            loop_start = time.time()
+class DropOldestQueue:
+    """Bounded hand-off between pipeline stages; a full queue discards its oldest item."""
+
+    def __init__(self, maxsize):
+        self.maxsize = maxsize
+        self.items = deque()
+        self.cond = threading.Condition()
+        self.dropped = 0
+
+    def put(self, item):
+        with self.cond:
+            if len(self.items) >= self.maxsize:
+                self.items.popleft()
+                self.dropped += 1
+            self.items.append(item)
+            self.cond.notify()
+
+    def get(self, timeout):
+        with self.cond:
+            if not self.items:
+                self.cond.wait(timeout)
+            return self.items.popleft() if self.items else None
+
+    def __len__(self):
+        return len(self.items)
+
+class PipelineStats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.reset()
+
+    def reset(self):
+        self.frames = 0
+        self.capture_ms = self.encode_ms = self.send_ms = 0.0
+        self.latency_ms = self.latency_max = 0.0
+        self.size = 0
+        self.start = time.time()
 
-            # Capture frame
-            t1 = time.time()
+    def add(self, capture_ms, encode_ms, send_ms, latency_ms, size):
+        """Accumulate one sent frame; returns a summary dict every 10 frames."""
+        with self.lock:
+            self.frames += 1
+            self.capture_ms += capture_ms
+            self.encode_ms += encode_ms
+            self.send_ms += send_ms
+            self.latency_ms += latency_ms
+            self.latency_max = max(self.latency_max, latency_ms)
+            self.size = size
+            if self.frames < 10:
+                return None
+            n = self.frames
+            snapshot = {
+                "fps": n / (time.time() - self.start),
+                "capture_ms": self.capture_ms / n,
+                "encode_ms": self.encode_ms / n,
+                "send_ms": self.send_ms / n,
+                "latency_ms": self.latency_ms / n,
+                "latency_max": self.latency_max,
+                "size": self.size,
+            }
+            self.reset()
+            return snapshot
+
+def parse_cameras(spec):
+    """'CAM0=0,CAM1=/dev/video2,CAM2=clip.mp4' -> [("CAM0", 0), ("CAM1", "/dev/video2"), ...]"""
+    cameras = []
+    for entry in spec.split(","):
+        entry = entry.strip()
+        if not entry:
+            continue
+        name, _, source = entry.partition("=")
+        source = source.strip() or str(len(cameras))
+        cameras.append((name.strip(), int(source) if source.isdigit() else source))
+    return cameras
+
+def is_file_source(source):
+    return isinstance(source, str) and not source.startswith("/dev/")
+
+def capture_loop(cam, source, encode_q, stop):
+    """Read frames on a fixed schedule; never waits on encode or the network."""
+    next_tick = time.monotonic()
+    while not stop.is_set():
+        t1 = time.time()
+        ret, frame = cam.read()
+        if not ret and is_file_source(source):
+            # Video files stand in for cameras: loop them forever
+            cam.set(cv2.CAP_PROP_POS_FRAMES, 0)
             ret, frame = cam.read()
-            if not ret:
-                log("Frame capture failed", "WARN")
-                continue
+        if not ret:
+            log("Frame capture failed", "WARN")
+        else:
             capture_time = (time.time() - t1) * 1000
+            encode_q.put((frame, get_timestamp(), get_frame_name(), capture_time))
+
+        next_tick += CAPTURE_INTERVAL
+        delay = next_tick - time.monotonic()
+        if delay < 0:
+            missed = int(-delay // CAPTURE_INTERVAL) + 1
+            log(f"WARNING: Capture fell {-delay*1000:.0f}ms behind, skipping {missed} tick(s)", "WARN")
+            next_tick += missed * CAPTURE_INTERVAL
+            delay = next_tick - time.monotonic()
+        stop.wait(max(0, delay))
+
+def capture_codec(cam, cam_no, source):
+    """Pick the transport codec for an opened capture from what it will actually deliver.
+
+    YUYV is only real when a device accepted the FOURCC; video files (and
+    drivers that refuse it) decode to BGR, which is then sent as bgr24.
+    """
+    codec = CODECS.get(PIXEL_FORMAT, CODEC_BMP)
+    if codec != CODEC_YUYV:
+        return codec
+    if not is_file_source(source):
+        # Ask the driver for unconverted 4:2:2 frames
+        cam.set(cv2.CAP_PROP_FOURCC, cv2.VideoWriter_fourcc(*"YUYV"))
+        cam.set(cv2.CAP_PROP_CONVERT_RGB, 0)
+        if int(cam.get(cv2.CAP_PROP_FOURCC)) == cv2.VideoWriter_fourcc(*"YUYV"):
+            return CODEC_YUYV
+        cam.set(cv2.CAP_PROP_CONVERT_RGB, 1)
+    log(f"[{cam_no}] {source!r} does not deliver YUYV; sending bgr24 instead", "WARN")
+    return CODEC_BGR24
 
-            # Encode to BMP (no compression)
-            t2 = time.time()
-            ret, bmp_buffer = cv2.imencode('.bmp', frame)
-            if not ret:
+def encode_loop(encode_q, send_q, codec, width, height, stop):
+    bytes_per_pixel = 2 if codec == CODEC_YUYV else 3
+
+    while not stop.is_set():
+        item = encode_q.get(0.5)
+        if item is None:
+            continue
+        frame, timestamp, filename, capture_time = item
+
+        t2 = time.time()
+        if codec != CODEC_BMP:
+            # Raw transport: ship the pixel planes as captured, the server builds headers on demand
+            fmt = (codec, width, height, width * bytes_per_pixel)
+            frame_bytes = memoryview(frame).cast("B")
+        else:
+            # Encode to BMP (no compression), as a flat zero-copy view for the scatter-gather send
+            fmt = None
+            frame_bytes = encode_bmp(frame)
+            if frame_bytes is None:
                 log("Frame encoding failed", "WARN")
                 continue
-            encode_time = (time.time() - t2) * 1000
-
-            frame_bytes = bmp_buffer.tobytes()
-            timestamp = get_timestamp()
-            filename = get_frame_name()
-
-            # Send to Node.js
-            t3 = time.time()
-            if not send_frame_data(sock, "CAM0", frame_bytes, timestamp, filename):
-                log("Connection lost, reconnecting...", "WARN")
-                sock.close()
-                while True:
-                    try:
-                        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-                        sock.connect((NODE_HOST, NODE_PORT))
-                        log("Reconnected to Node.js")
-                        break
-                    except:
-                        time.sleep(1)
+        encode_time = (time.time() - t2) * 1000
+
+        send_q.put((frame_bytes, fmt, frame, timestamp, filename, capture_time, encode_time))
+
+class DirectSink:
+    """A camera's own connection to the server (TCP or shared memory)."""
+
+    def __init__(self):
+        self.conn, self.version = connect_node()
+        self.dropped_before = 0  # by earlier shared-memory connections
+
+    @property
+    def dropped(self):
+        """Frames the transport discarded (shared-memory ring only; TCP sends block instead)."""
+        return self.dropped_before + getattr(self.conn, "dropped", 0)
+
+    def send(self, cam_no, frame_bytes, fmt, frame, timestamp, filename):
+        # Servers without the v2 protocol only understand BMP
+        if fmt and self.version == 1:
+            frame_bytes, fmt = encode_bmp(frame, fmt), None
+            if frame_bytes is None:
+                return False
+
+        if not send_frame(self.conn, self.version, cam_no, frame_bytes, timestamp, filename, fmt):
+            log("Connection lost, reconnecting...", "WARN")
+            self.dropped_before = self.dropped
+            self.conn.close()
+            self.conn, self.version = connect_node()
+            return False
+        return True
+
+    def close(self):
+        self.conn.close()
+
+class MuxSink:
+    """Hands frames to the supervisor, which multiplexes every camera onto one connection.
+
+    Frames cross the process boundary by copy, so this trades bandwidth for a single socket.
+    """
+
+    def __init__(self, mux_q):
+        self.mux_q = mux_q
+        self.dropped = 0
+
+    def send(self, cam_no, frame_bytes, fmt, frame, timestamp, filename):
+        try:
+            self.mux_q.put_nowait((cam_no, bytes(frame_bytes), fmt, timestamp, filename))
+        except queue.Full:
+            self.dropped += 1
+        return True
+
+    def close(self):
+        pass
+
+def send_loop(sink, cam_no, encode_q, send_q, stats, stop, report):
+    frame_count = 0
+    while not stop.is_set():
+        item = send_q.get(0.5)
+        if item is None:
+            continue
+        frame_bytes, fmt, frame, timestamp, filename, capture_time, encode_time = item
+
+        # Send to Node.js
+        t3 = time.time()
+        dropped = sink.dropped
+        if not sink.send(cam_no, frame_bytes, fmt, frame, timestamp, filename) or sink.dropped != dropped:
+            continue
+        send_time = (time.time() - t3) * 1000
+
+        frame_count += 1
+        latency = get_timestamp() - timestamp
+        snapshot = stats.add(capture_time, encode_time, send_time, latency, len(frame_bytes))
+
+        # Report every 10 frames
+        if snapshot:
+            snapshot.update(
+                frames=frame_count,
+                encode_q=len(encode_q), encode_dropped=encode_q.dropped,
+                send_q=len(send_q), send_dropped=send_q.dropped,
+                sink_dropped=sink.dropped,
+            )
+            report(snapshot)
+
+    sink.close()
+    log(f"[{cam_no}] Sender stopped. Total frames: {frame_count}")
+
+def camera_process(cam_no, source, core, mux_q, stats_q):
+    """One camera: capture -> encode -> send, each stage on its own thread."""
+    supervisor = os.getppid()
+    signal.signal(signal.SIGINT, signal.default_int_handler)
+    # Frames and stats are disposable: never block process exit flushing them
+    stats_q.cancel_join_thread()
+    if mux_q is not None:
+        mux_q.cancel_join_thread()
+    if core is not None:
+        os.sched_setaffinity(0, {core})
+
+    cam = cv2.VideoCapture(source)
+    if not cam.isOpened():
+        log(f"[{cam_no}] FATAL: Could not open camera source {source!r}", "ERROR")
+        log("Check: ls -l /dev/video* to verify camera is connected", "ERROR")
+        return
+
+    cam.set(cv2.CAP_PROP_BUFFERSIZE, 1)
+    codec = capture_codec(cam, cam_no, source)
+    width = int(cam.get(cv2.CAP_PROP_FRAME_WIDTH))
+    height = int(cam.get(cv2.CAP_PROP_FRAME_HEIGHT))
+    pinned = f", core {core}" if core is not None else ""
+    log(f"[{cam_no}] Camera opened: {source!r} {width}x{height} (transport format: {CODEC_NAMES[codec]}{pinned})")
+
+    sink = MuxSink(mux_q) if mux_q is not None else DirectSink()
+
+    stop = threading.Event()
+    encode_q = DropOldestQueue(ENCODE_QUEUE_MAX)
+    send_q = DropOldestQueue(SEND_QUEUE_MAX)
+    stats = PipelineStats()
+
+    def report(snapshot):
+        try:
+            stats_q.put_nowait((cam_no, snapshot))
+        except queue.Full:
+            pass
+
+    threads = [
+        threading.Thread(target=capture_loop, args=(cam, source, encode_q, stop), name="capture"),
+        threading.Thread(target=encode_loop, args=(encode_q, send_q, codec, width, height, stop), name="encode"),
+        threading.Thread(target=send_loop, args=(sink, cam_no, encode_q, send_q, stats, stop, report), name="send"),
+    ]
+    for t in threads:
+        t.daemon = True
+        t.start()
+
+    try:
+        while all(t.is_alive() for t in threads):
+            time.sleep(0.5)
+            if os.getppid() != supervisor:
+                log(f"[{cam_no}] Supervisor gone, stopping", "WARN")
+                return
+        log(f"[{cam_no}] A pipeline thread exited unexpectedly", "ERROR")
+    except KeyboardInterrupt:
+        pass
+    finally:
+        stop.set()
+        for t in threads:
+            t.join(timeout=2)
+        cam.release()
+
+def mux_sender(mux_q, stop):
+    """Supervisor side of CAMERA_MUX: drain every camera's frames onto one connection."""
+    conn, version = connect_node()
+    while not stop.is_set():
+        try:
+            cam_no, frame_bytes, fmt, timestamp, filename = mux_q.get(timeout=0.5)
+        except queue.Empty:
+            continue
+
+        if fmt and version == 1:
+            import numpy as np
+            shape = (fmt[2], fmt[1], 2) if fmt[0] == CODEC_YUYV else (fmt[2], fmt[1], 3)
+            frame_bytes, fmt = encode_bmp(np.frombuffer(frame_bytes, np.uint8).reshape(shape), fmt), None
+            if frame_bytes is None:
                 continue
 
-            send_time = (time.time() - t3) * 1000
+        if not send_frame(conn, version, cam_no, frame_bytes, timestamp, filename, fmt):
+            log("Connection lost, reconnecting...", "WARN")
+            conn.close()
+            conn, version = connect_node()
+    conn.close()
+
+def log_camera_stats(latest):
+    for cam_no, snap in sorted(latest.items()):
+        log(f"{cam_no} | Frame {snap['frames']} | FPS: {snap['fps']:.1f} | "
+            f"Latency: {snap['latency_ms']:.1f}ms (max {snap['latency_max']:.0f}ms) | "
+            f"Capture: {snap['capture_ms']:.1f}ms | "
+            f"Encode: {snap['encode_ms']:.1f}ms | "
+            f"Send: {snap['send_ms']:.1f}ms | "
+            f"Size: {snap['size']/1024:.0f}KB | "
+            f"Encode Q: {snap['encode_q']} (dropped {snap['encode_dropped']}) | "
+            f"Send Q: {snap['send_q']} (dropped {snap['send_dropped']}) | "
+            f"Transport dropped: {snap['sink_dropped']}")
+
+def stop_on_sigterm(signum, frame):
+    raise KeyboardInterrupt
+
+def main():
+    log("Camera capture service starting...")
+    signal.signal(signal.SIGTERM, stop_on_sigterm)
+
+    cameras = parse_cameras(CAMERAS)
+    if not cameras:
+        log("FATAL: No cameras configured (CAMERAS is empty)", "ERROR")
+        return
+    too_long = [name for name, _ in cameras if len(name.encode()) > V2_CAMNO_MAX]
+    if too_long:
+        # The v2 header holds 8 bytes; cutting names short would merge cameras
+        log(f"FATAL: Camera names longer than {V2_CAMNO_MAX} bytes: {', '.join(too_long)}", "ERROR")
+        return
+
+    # Connect to Node.js
+    if TRANSPORT == "shm":
+        log(f"Transport: shared-memory ring at {SHM_SOCKET_PATH}")
+    else:
+        log(f"Transport: Node.js at {NODE_HOST}:{NODE_PORT}" + (" (multiplexed)" if CAMERA_MUX else ""))
+    log(f"Starting {len(cameras)} camera(s) at {1/CAPTURE_INTERVAL:.1f} FPS: "
+        + ", ".join(f"{name}={source}" for name, source in cameras))
+
+    ctx = mp.get_context("spawn")
+    stats_q = ctx.Queue(256)
+    mux_q = ctx.Queue(MUX_QUEUE_MAX) if CAMERA_MUX else None
+    cores = sorted(os.sched_getaffinity(0))
+
+    def spawn(index):
+        cam_no, source = cameras[index]
+        core = cores[index % len(cores)] if CAMERA_PIN_CORES else None
+        proc = ctx.Process(target=camera_process, args=(cam_no, source, core, mux_q, stats_q),
+                           name=f"camera-{cam_no}", daemon=True)
+        proc.start()
+        return proc
 
-            frame_count += 1
-            stats_capture += capture_time
-            stats_encode += encode_time
-            stats_send += send_time
+    procs = [spawn(i) for i in range(len(cameras))]
+    restart_at = [None] * len(cameras)
 
-            # Log every 10 frames
-            if frame_count % 10 == 0:
-                elapsed = time.time() - stats_start
-                fps = 10 / elapsed
-                log(f"Frame {frame_count} | FPS: {fps:.1f} | "
-                    f"Capture: {stats_capture/10:.1f}ms | "
-                    f"Encode: {stats_encode/10:.1f}ms | "
-                    f"Send: {stats_send/10:.1f}ms | "
-                    f"Size: {len(frame_bytes)/1024:.0f}KB")
+    stop = threading.Event()
+    sender = None
+    if mux_q is not None:
+        sender = threading.Thread(target=mux_sender, args=(mux_q, stop), name="mux-send", daemon=True)
+        sender.start()
 
-                stats_capture = stats_encode = stats_send = 0
-                stats_start = time.time()
+    latest = {}
+    next_report = time.monotonic() + STATS_INTERVAL
 
-            loop_time = (time.time() - loop_start) * 1000
-            if loop_time > CAPTURE_INTERVAL * 1000:
-                log(f"WARNING: Loop took {loop_time:.0f}ms (target: {CAPTURE_INTERVAL*1000:.0f}ms)", "WARN")
+    try:
+        while True:
+            try:
+                cam_no, snapshot = stats_q.get(timeout=0.5)
+                latest[cam_no] = snapshot
+            except queue.Empty:
+                pass
 
-            time.sleep(max(0, CAPTURE_INTERVAL - (time.time() - loop_start)))
+            # Supervise: restart camera processes that died
+            for i, proc in enumerate(procs):
+                if proc.is_alive():
+                    continue
+                if restart_at[i] is None:
+                    log(f"{cameras[i][0]} process exited (code {proc.exitcode}), "
+                        f"restarting in {RESTART_DELAY}s", "WARN")
+                    restart_at[i] = time.monotonic() + RESTART_DELAY
+                    latest.pop(cameras[i][0], None)
+                elif time.monotonic() >= restart_at[i]:
+                    procs[i] = spawn(i)
+                    restart_at[i] = None
+
+            if time.monotonic() >= next_report:
+                log_camera_stats(latest)
+                next_report = time.monotonic() + STATS_INTERVAL
 
     except KeyboardInterrupt:
         log("\nStopped by user (Ctrl+C)")
@@ -149,12 +683,17 @@ def main():
         import traceback
         traceback.print_exc()
     finally:
-        cam.release()
-        sock.close()
-        log(f"Shutdown complete. Total frames: {frame_count}")
+        stop.set()
+        for proc in procs:
+            if proc.is_alive():
+                os.kill(proc.pid, signal.SIGINT)
+        for proc in procs:
+            proc.join(timeout=3)
+            if proc.is_alive():
+                proc.terminate()
+        if sender:
+            sender.join(timeout=2)
+        log("Shutdown complete")
 
 if __name__ == "__main__":
     main()
-
-
-
@@ -2,15 +2,30 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdint.h>
 #include <time.h>
 #include <sys/time.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <unistd.h>
 #include <curl/curl.h>
 #include <cjson/cJSON.h>
 
 #define API_BASE_URL "http://localhost:3005"
 #define IMAGE_BUFFER_SIZE 921654
 #define MAX_FILENAME 256
+#define QUERY_MAX_CAMERAS 16 // must match MAX_CAMERAS in server/framesQuery.js
+
+// TCP ingest protocol (must match server/ingestProtocol.js)
+#define STREAM_DEFAULT_HOST "localhost"
+#define STREAM_DEFAULT_PORT "9000"
+#define STREAM_PROTOCOL_VERSION 2
+#define STREAM_BANNER_MAGIC 0x53565056u  // 'SVPV'
+#define STREAM_FRAME_MAGIC_V2 0x53564632u // 'SVF2'
+#define STREAM_V2_HEADER_SIZE 32
+#define STREAM_CODEC_BMP 0
+#define STREAM_CAMNO_MAX 8 // v2 header camNo field, NUL padded
 
 typedef struct imgInfo
 {
@@ -28,7 +43,8 @@ typedef struct imgInfo
 
 typedef struct
 {
-  char *camNo;
+  const char *cameras[QUERY_MAX_CAMERAS]; // several cameras come back merged in time order
+  int camera_count;
   int year;
   int month;
   int day;
@@ -302,6 +318,27 @@ int imgDataPost(imgInfo_t iInfo, unsigned char imgData_p[], size_t img_size)
   return result;
 }
 
+// Build /api/frames URL with optional filters
+static void build_frames_url(char *query_url, size_t size, QueryParams params)
+{
+  int len = snprintf(query_url, size, "%s/api/frames?camNo=", API_BASE_URL);
+  for (int i = 0; i < params.camera_count; i++)
+    len += snprintf(query_url + len, size - len, "%s%s", i ? "," : "", params.cameras[i]);
+
+  if (params.year > 0)
+    len += snprintf(query_url + len, size - len, "&year=%d", params.year);
+  if (params.month > 0)
+    len += snprintf(query_url + len, size - len, "&month=%d", params.month);
+  if (params.day > 0)
+    len += snprintf(query_url + len, size - len, "&day=%d", params.day);
+  if (params.hour >= 0)
+    len += snprintf(query_url + len, size - len, "&hour=%d", params.hour);
+  if (params.minute >= 0)
+    len += snprintf(query_url + len, size - len, "&minute=%d", params.minute);
+  if (params.second >= 0)
+    len += snprintf(query_url + len, size - len, "&second=%d", params.second);
+}
+
 // IMAGE DATA GET - Retrieve metadata and file from API
 int imgDataGet(QueryParams params, unsigned char imgData_g[])
 {
@@ -315,21 +352,7 @@ int imgDataGet(QueryParams params, unsigned char imgData_g[])
 
   // Build query URL with optional parameters
   char query_url[1024];
-  int len = snprintf(query_url, sizeof(query_url), "%s/api/frames?camNo=%s",
-                     API_BASE_URL, params.camNo);
-
-  if (params.year > 0)
-    len += snprintf(query_url + len, sizeof(query_url) - len, "&year=%d", params.year);
-  if (params.month > 0)
-    len += snprintf(query_url + len, sizeof(query_url) - len, "&month=%d", params.month);
-  if (params.day > 0)
-    len += snprintf(query_url + len, sizeof(query_url) - len, "&day=%d", params.day);
-  if (params.hour >= 0)
-    len += snprintf(query_url + len, sizeof(query_url) - len, "&hour=%d", params.hour);
-  if (params.minute >= 0)
-    len += snprintf(query_url + len, sizeof(query_url) - len, "&minute=%d", params.minute);
-  if (params.second >= 0)
-    len += snprintf(query_url + len, sizeof(query_url) - len, "&second=%d", params.second);
+  build_frames_url(query_url, sizeof(query_url), params);
 
   printf("Query URL: %s\n", query_url);
 
@@ -414,6 +437,569 @@ int imgDataGet(QueryParams params, unsigned char imgData_g[])
   return 0;
 }
 
+// ============================================================================
+// NDJSON STREAMING GET
+// ============================================================================
+
+// Rows arrive one JSON object per line; partial lines are carried between chunks
+typedef struct
+{
+  char *line;
+  size_t len;
+  size_t cap;
+  long rows;
+  int failed;
+  char first_filename[MAX_FILENAME];
+} NdjsonState;
+
+static void ndjson_row(NdjsonState *st, const char *line)
+{
+  cJSON *row = cJSON_Parse(line);
+  if (!row)
+  {
+    printf("ERROR: Bad NDJSON line: %.80s\n", line);
+    st->failed = 1;
+    return;
+  }
+
+  cJSON *error = cJSON_GetObjectItem(row, "error");
+  cJSON *location = cJSON_GetObjectItem(row, "l_location");
+  if (error && cJSON_IsString(error))
+  {
+    printf("ERROR: Server: %s\n", error->valuestring);
+    st->failed = 1;
+  }
+  else if (location && cJSON_IsString(location))
+  {
+    const char *last_slash = strrchr(location->valuestring, '/');
+    const char *name = last_slash ? last_slash + 1 : location->valuestring;
+    if (st->rows == 0)
+    {
+      cJSON *cam = cJSON_GetObjectItem(row, "camNo");
+      snprintf(st->first_filename, sizeof(st->first_filename), "%s", name);
+      printf("First frame: %s (%s)\n", name, cam && cJSON_IsString(cam) ? cam->valuestring : "?");
+    }
+    st->rows++;
+    if (st->rows % 1000 == 0)
+      printf("  %ld rows...\n", st->rows);
+  }
+
+  cJSON_Delete(row);
+}
+
+static size_t ndjson_callback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+  size_t realsize = size * nmemb;
+  NdjsonState *st = (NdjsonState *)userp;
+  const char *p = (const char *)contents;
+  const char *end = p + realsize;
+
+  while (p < end)
+  {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    size_t seg = (size_t)((nl ? nl : end) - p);
+
+    if (st->len + seg + 1 > st->cap)
+    {
+      size_t cap = st->cap ? st->cap : 512;
+      while (cap < st->len + seg + 1)
+        cap *= 2;
+      char *grown = realloc(st->line, cap);
+      if (!grown)
+      {
+        printf("ERROR: Not enough memory for NDJSON line\n");
+        return 0;
+      }
+      st->line = grown;
+      st->cap = cap;
+    }
+    memcpy(st->line + st->len, p, seg);
+    st->len += seg;
+
+    if (!nl)
+      break;
+
+    st->line[st->len] = '\0';
+    if (st->len > 0)
+      ndjson_row(st, st->line);
+    st->len = 0;
+    p = nl + 1;
+  }
+
+  return realsize;
+}
+
+// IMAGE DATA GET (streamed) - rows are handled as they arrive, no row cap
+int imgDataGetStream(QueryParams params)
+{
+  CURL *curl = curl_easy_init();
+  if (!curl)
+  {
+    printf("ERROR: CURL initialization failed\n");
+    return -1;
+  }
+
+  char query_url[1024];
+  build_frames_url(query_url, sizeof(query_url), params);
+  printf("Query URL (NDJSON): %s\n", query_url);
+
+  struct curl_slist *headers = NULL;
+  headers = curl_slist_append(headers, "Accept: application/x-ndjson");
+
+  NdjsonState st = {0};
+  curl_easy_setopt(curl, CURLOPT_URL, query_url);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, ndjson_callback);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &st);
+
+  long long start = get_current_timestamp_ms();
+  CURLcode res = curl_easy_perform(curl);
+  long http_code = 0;
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+  // A final line without a trailing newline
+  if (res == CURLE_OK && st.len > 0)
+  {
+    st.line[st.len] = '\0';
+    ndjson_row(&st, st.line);
+  }
+
+  int result = 0;
+  if (res != CURLE_OK)
+  {
+    printf("ERROR: Query failed: %s\n", curl_easy_strerror(res));
+    result = -1;
+  }
+  else if (http_code != 200 || st.failed)
+  {
+    printf("ERROR: Stream failed (HTTP %ld)\n", http_code);
+    result = -1;
+  }
+  else if (st.rows == 0)
+  {
+    printf("ERROR: No frames found in response\n");
+    result = -1;
+  }
+  else
+  {
+    printf("Streamed %ld frames in %lld ms\n", st.rows, get_current_timestamp_ms() - start);
+  }
+
+  free(st.line);
+  curl_slist_free_all(headers);
+  curl_easy_cleanup(curl);
+  return result;
+}
+
+// ============================================================================
+// COLUMNAR GET
+// ============================================================================
+
+// Binary columnar /api/frames payload (must match server/columnar.js)
+#define COLUMNAR_MAGIC 0x46435653u // 'SVCF'
+#define COLUMNAR_VERSION 1
+#define COLUMNAR_HAS_SUB 1
+#define COLUMNAR_HEADER_SIZE 32
+#define COLUMNAR_JUMP_DELTA 0xFFFFFFFFu
+
+// Views into the response buffer; rows are decoded in place, nothing is allocated per row
+// (only the template index, once per response: free it with columnar_free)
+typedef struct
+{
+  uint32_t count;
+  uint32_t template_count;
+  uint32_t jump_count;
+  double base_ts;
+  const unsigned char *jumps;
+  const char *cam_no;
+  uint16_t cam_no_len;
+  const char **templates;
+  uint16_t *template_lens;
+  const unsigned char *deltas;
+  const unsigned char *ids;
+  const unsigned char *subs; // NULL unless COLUMNAR_HAS_SUB
+} ColumnarView;
+
+static uint16_t get_le16(const unsigned char *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_le32(const unsigned char *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static double get_le_double(const unsigned char *p)
+{
+  uint64_t bits = (uint64_t)get_le32(p) | ((uint64_t)get_le32(p + 4) << 32);
+  double v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+static size_t pad4(size_t n)
+{
+  return (n + 3) & ~(size_t)3;
+}
+
+static void columnar_free(ColumnarView *v)
+{
+  free(v->templates);
+  free(v->template_lens);
+  v->templates = NULL;
+  v->template_lens = NULL;
+}
+
+static int columnar_parse(const unsigned char *data, size_t size, ColumnarView *v)
+{
+  if (size < COLUMNAR_HEADER_SIZE || get_le32(data) != COLUMNAR_MAGIC)
+  {
+    printf("ERROR: Not a columnar frames payload\n");
+    return -1;
+  }
+  if (get_le16(data + 4) != COLUMNAR_VERSION)
+  {
+    printf("ERROR: Unsupported columnar version %u\n", get_le16(data + 4));
+    return -1;
+  }
+
+  uint16_t flags = get_le16(data + 6);
+  v->count = get_le32(data + 8);
+  v->template_count = get_le32(data + 12);
+  v->jump_count = get_le32(data + 16);
+  v->cam_no_len = get_le16(data + 20);
+  v->base_ts = get_le_double(data + 24);
+
+  v->templates = NULL;
+  v->template_lens = NULL;
+
+  size_t off = COLUMNAR_HEADER_SIZE;
+  v->jumps = data + off;
+  off += (size_t)v->jump_count * 8;
+  if (off + v->cam_no_len > size)
+    goto truncated;
+  v->cam_no = (const char *)data + off;
+  off += v->cam_no_len;
+
+  if (v->template_count > (size - off) / 2)
+    goto truncated;
+  v->templates = malloc(v->template_count * sizeof(*v->templates) + 1);
+  v->template_lens = malloc(v->template_count * sizeof(*v->template_lens) + 1);
+  if (!v->templates || !v->template_lens)
+  {
+    printf("ERROR: Not enough memory for location templates\n");
+    columnar_free(v);
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < v->template_count; i++)
+  {
+    if (off + 2 > size)
+      goto truncated;
+    v->template_lens[i] = get_le16(data + off);
+    v->templates[i] = (const char *)data + off + 2;
+    off += 2 + v->template_lens[i];
+  }
+
+  off = pad4(off);
+  v->deltas = data + off;
+  off += (size_t)v->count * 4;
+  v->ids = data + off;
+  off = pad4(off + (size_t)v->count * 2);
+  v->subs = NULL;
+  if (flags & COLUMNAR_HAS_SUB)
+  {
+    v->subs = data + off;
+    off = pad4(off + (size_t)v->count * 2);
+  }
+  if (off > size)
+    goto truncated;
+
+  for (uint32_t i = 0; i < v->count; i++)
+  {
+    if (get_le16(v->ids + (size_t)i * 2) >= v->template_count)
+    {
+      printf("ERROR: Bad location id at row %u\n", i);
+      columnar_free(v);
+      return -1;
+    }
+  }
+  return 0;
+
+truncated:
+  printf("ERROR: Truncated columnar payload (%zu bytes)\n", size);
+  columnar_free(v);
+  return -1;
+}
+
+// yyMMddhhmmss_mmm for a wall-clock ms timestamp (tb_index fields read as UTC)
+static void columnar_stem(double ts, char *out, size_t size)
+{
+  long long ms = (long long)ts;
+  long long days = ms / 86400000LL;
+  long long rem = ms % 86400000LL;
+  if (rem < 0)
+  {
+    rem += 86400000LL;
+    days--;
+  }
+
+  // days since 1970-01-01 -> civil date
+  long long z = days + 719468;
+  long long era = (z >= 0 ? z : z - 146096) / 146097;
+  long long doe = z - era * 146097;
+  long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  long long mp = (5 * doy + 2) / 153;
+  int day = (int)(doy - (153 * mp + 2) / 5 + 1);
+  int month = (int)(mp < 10 ? mp + 3 : mp - 9);
+  long long year = yoe + era * 400 + (month <= 2);
+
+  snprintf(out, size, "%02d%02d%02d%02d%02d%02d_%03d",
+           (int)(year % 100), month, day,
+           (int)(rem / 3600000), (int)(rem / 60000 % 60), (int)(rem / 1000 % 60), (int)(rem % 1000));
+}
+
+// Expand row i's location template ({ts}, {sub}) into out
+static void columnar_location(const ColumnarView *v, uint32_t i, double ts, char *out, size_t size)
+{
+  uint16_t id = get_le16(v->ids + (size_t)i * 2);
+  const char *t = v->templates[id];
+  const char *end = t + v->template_lens[id];
+  size_t len = 0;
+
+  while (t < end && len + 1 < size)
+  {
+    if (end - t >= 4 && memcmp(t, "{ts}", 4) == 0)
+    {
+      char stem[32];
+      columnar_stem(ts, stem, sizeof(stem));
+      len += (size_t)snprintf(out + len, size - len, "%s", stem);
+      t += 4;
+    }
+    else if (end - t >= 5 && memcmp(t, "{sub}", 5) == 0)
+    {
+      int sub = v->subs ? get_le16(v->subs + (size_t)i * 2) : 0;
+      len += (size_t)snprintf(out + len, size - len, "%03d", sub);
+      t += 5;
+    }
+    else
+    {
+      out[len++] = *t++;
+    }
+    if (len >= size)
+      len = size - 1;
+  }
+  out[len] = '\0';
+}
+
+// IMAGE DATA GET (columnar) - binary typed-array payload, decoded in place
+int imgDataGetColumnar(QueryParams params)
+{
+  CURL *curl = curl_easy_init();
+  if (!curl)
+  {
+    printf("ERROR: CURL initialization failed\n");
+    return -1;
+  }
+
+  char query_url[1024];
+  build_frames_url(query_url, sizeof(query_url), params);
+  strncat(query_url, "&format=columnar&binary=1", sizeof(query_url) - strlen(query_url) - 1);
+  printf("Query URL (columnar): %s\n", query_url);
+
+  HttpResponse response = {0};
+  curl_easy_setopt(curl, CURLOPT_URL, query_url);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+
+  CURLcode res = curl_easy_perform(curl);
+  long http_code = 0;
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+  curl_easy_cleanup(curl);
+
+  if (res != CURLE_OK)
+  {
+    printf("ERROR: Query failed: %s\n", curl_easy_strerror(res));
+    free(response.data);
+    return -1;
+  }
+  if (http_code != 200 || !response.data)
+  {
+    printf("ERROR: Query failed (HTTP %ld)%s%s\n", http_code,
+           response.data ? ": " : "", response.data ? response.data : "");
+    free(response.data);
+    return -1;
+  }
+
+  ColumnarView v;
+  if (columnar_parse((const unsigned char *)response.data, response.size, &v) != 0)
+  {
+    free(response.data);
+    return -1;
+  }
+  printf("Received %u frames of %.*s in %zu bytes (%u location templates)\n",
+         v.count, (int)v.cam_no_len, v.cam_no, response.size, v.template_count);
+
+  if (v.count == 0)
+  {
+    printf("ERROR: No frames found in response\n");
+    columnar_free(&v);
+    free(response.data);
+    return -1;
+  }
+
+  double ts = v.base_ts;
+  double first_ts = 0;
+  uint32_t jump = 0;
+  char location[MAX_FILENAME];
+  for (uint32_t i = 0; i < v.count; i++)
+  {
+    uint32_t delta = get_le32(v.deltas + (size_t)i * 4);
+    if (delta != COLUMNAR_JUMP_DELTA)
+      ts += delta;
+    else if (jump < v.jump_count)
+      ts = get_le_double(v.jumps + (size_t)jump++ * 8);
+
+    if (i == 0)
+    {
+      first_ts = ts;
+      columnar_location(&v, i, ts, location, sizeof(location));
+      const char *last_slash = strrchr(location, '/');
+      printf("First frame: %s\n", last_slash ? last_slash + 1 : location);
+    }
+  }
+
+  columnar_location(&v, v.count - 1, ts, location, sizeof(location));
+  const char *last_slash = strrchr(location, '/');
+  printf("Last frame:  %s (%.1f s after the first)\n", last_slash ? last_slash + 1 : location,
+         (ts - first_ts) / 1000.0);
+
+  columnar_free(&v);
+  free(response.data);
+  return 0;
+}
+
+// ============================================================================
+// NEAREST FRAME GET
+// ============================================================================
+
+// X-Frame-* response headers of /api/frames/nearest?image=1
+typedef struct
+{
+  long long timestamp;
+  long long offset_ms;
+  char location[MAX_FILENAME];
+} NearestInfo;
+
+static size_t nearest_header_callback(char *buffer, size_t size, size_t nitems, void *userp)
+{
+  size_t len = size * nitems;
+  NearestInfo *info = (NearestInfo *)userp;
+  char line[MAX_FILENAME + 32];
+
+  if (len >= sizeof(line))
+    return len;
+  memcpy(line, buffer, len);
+  line[len] = '\0';
+  line[strcspn(line, "\r\n")] = '\0';
+
+  if (strncasecmp(line, "X-Frame-Timestamp:", 18) == 0)
+    info->timestamp = atoll(line + 18);
+  else if (strncasecmp(line, "X-Frame-Offset-Ms:", 18) == 0)
+    info->offset_ms = atoll(line + 18);
+  else if (strncasecmp(line, "X-Frame-Location:", 17) == 0)
+    snprintf(info->location, sizeof(info->location), "%s", line + 17 + strspn(line + 17, " "));
+
+  return len;
+}
+
+// "HH:MM:SS[.mmm]" on the given day, or epoch ms; -1 if unparsable
+long long parse_at_time(const char *at, int year, int month, int day)
+{
+  if (!strchr(at, ':'))
+  {
+    char *end;
+    long long ts = strtoll(at, &end, 10);
+    return (*end == '\0' && ts > 0) ? ts : -1;
+  }
+
+  int hour = 0, minute = 0, second = 0, millis = 0;
+  if (sscanf(at, "%d:%d:%d.%d", &hour, &minute, &second, &millis) < 3 || year <= 0 || month <= 0 || day <= 0)
+    return -1;
+  return datetime_to_timestamp(year, month, day, hour, minute, second, millis);
+}
+
+// Frame closest to ts (dir: before | after | nearest), image and metadata in one request
+int imgDataGetAt(const char *camNo, long long ts, const char *dir, const char *output_path)
+{
+  CURL *curl = curl_easy_init();
+  if (!curl)
+  {
+    printf("ERROR: CURL initialization failed\n");
+    return -1;
+  }
+
+  char url[1024];
+  snprintf(url, sizeof(url), "%s/api/frames/nearest?camNo=%s&ts=%lld&dir=%s&image=1",
+           API_BASE_URL, camNo, ts, dir);
+  printf("Query URL: %s\n", url);
+
+  HttpResponse response = {0};
+  NearestInfo info = {0};
+  curl_easy_setopt(curl, CURLOPT_URL, url);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, nearest_header_callback);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, &info);
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+
+  CURLcode res = curl_easy_perform(curl);
+  long http_code = 0;
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+  curl_easy_cleanup(curl);
+
+  if (res != CURLE_OK)
+  {
+    printf("ERROR: Query failed: %s\n", curl_easy_strerror(res));
+    free(response.data);
+    return -1;
+  }
+  if (http_code != 200)
+  {
+    printf("ERROR: Nearest frame lookup failed (HTTP %ld)%s%s\n", http_code,
+           response.data ? ": " : "", response.data ? response.data : "");
+    free(response.data);
+    return -1;
+  }
+
+  FILE *fp = fopen(output_path, "wb");
+  if (!fp)
+  {
+    printf("ERROR: Cannot open file for writing: %s\n", output_path);
+    free(response.data);
+    return -1;
+  }
+  size_t written = fwrite(response.data, 1, response.size, fp);
+  fclose(fp);
+  free(response.data);
+  if (written != response.size)
+  {
+    printf("ERROR: Short write to %s\n", output_path);
+    return -1;
+  }
+
+  char when[32];
+  time_t sec = info.timestamp / 1000;
+  strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&sec));
+  printf("Frame at %s.%03lld (%+lld ms from requested): %s\n", when, info.timestamp % 1000,
+         info.offset_ms, info.location);
+  printf(" Saved %zu bytes to %s\n", written, output_path);
+  return 0;
+}
+
 // DOWNLOAD FILE FUNCTION
 int download_frame_file(const char *filename, const char *output_path)
 {
@@ -458,6 +1044,173 @@ int download_frame_file(const char *filename, const char *output_path)
   }
 }
 
+// ============================================================================
+// TCP STREAM CLIENT (port 9000)
+// ============================================================================
+
+static uint32_t crc32_update(uint32_t crc, const unsigned char *data, size_t len)
+{
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++)
+  {
+    crc ^= data[i];
+    for (int k = 0; k < 8; k++)
+      crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+  }
+  return ~crc;
+}
+
+static void put_be16(unsigned char *p, uint16_t v)
+{
+  p[0] = (unsigned char)(v >> 8);
+  p[1] = (unsigned char)v;
+}
+
+static void put_be32(unsigned char *p, uint32_t v)
+{
+  p[0] = (unsigned char)(v >> 24);
+  p[1] = (unsigned char)(v >> 16);
+  p[2] = (unsigned char)(v >> 8);
+  p[3] = (unsigned char)v;
+}
+
+static void put_be64(unsigned char *p, uint64_t v)
+{
+  put_be32(p, (uint32_t)(v >> 32));
+  put_be32(p + 4, (uint32_t)v);
+}
+
+static uint32_t get_be32(const unsigned char *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static int send_all(int fd, const void *data, size_t len)
+{
+  const unsigned char *p = (const unsigned char *)data;
+  while (len > 0)
+  {
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n <= 0)
+      return -1;
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+// Connect to the ingest port and negotiate the protocol version from the server banner
+int stream_connect(const char *host, const char *port, int *out_version)
+{
+  struct addrinfo hints = {0};
+  struct addrinfo *res = NULL;
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  if (getaddrinfo(host, port, &hints, &res) != 0)
+  {
+    printf("ERROR: Cannot resolve %s:%s\n", host, port);
+    return -1;
+  }
+
+  int fd = -1;
+  for (struct addrinfo *ai = res; ai; ai = ai->ai_next)
+  {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0)
+      continue;
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+      break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+
+  if (fd < 0)
+  {
+    printf("ERROR: Cannot connect to %s:%s\n", host, port);
+    return -1;
+  }
+
+  // Servers that predate the banner never send one: fall back to v1
+  struct timeval tv = {1, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  unsigned char banner[6];
+  size_t got = 0;
+  while (got < sizeof(banner))
+  {
+    ssize_t n = recv(fd, banner + got, sizeof(banner) - got, 0);
+    if (n <= 0)
+      break;
+    got += (size_t)n;
+  }
+
+  *out_version = 1;
+  if (got == sizeof(banner) && get_be32(banner) == STREAM_BANNER_MAGIC)
+  {
+    *out_version = banner[5] < STREAM_PROTOCOL_VERSION ? banner[5] : STREAM_PROTOCOL_VERSION;
+  }
+
+  printf("Connected to %s:%s (protocol v%d)\n", host, port, *out_version);
+  return fd;
+}
+
+// Send one frame using the negotiated protocol version
+int stream_send_frame(int fd, int version, const char *camNo, long long timestamp,
+                      const unsigned char *data, size_t size)
+{
+  if (version >= 2)
+  {
+    // A longer name would be cut short and could collide with another camera's
+    if (strlen(camNo) > STREAM_CAMNO_MAX)
+    {
+      fprintf(stderr, "ERROR: Camera name '%s' is longer than %d bytes\n", camNo, STREAM_CAMNO_MAX);
+      return -1;
+    }
+
+    unsigned char header[STREAM_V2_HEADER_SIZE] = {0};
+    put_be32(header, STREAM_FRAME_MAGIC_V2);
+    header[4] = 2;
+    header[5] = STREAM_CODEC_BMP;
+    put_be16(header + 6, STREAM_V2_HEADER_SIZE);
+    strncpy((char *)header + 8, camNo, 8);
+    put_be64(header + 16, (uint64_t)timestamp);
+    put_be32(header + 24, (uint32_t)size);
+    put_be32(header + 28, crc32_update(0, header, 28));
+
+    if (send_all(fd, header, sizeof(header)) != 0 || send_all(fd, data, size) != 0)
+      return -1;
+    return 0;
+  }
+
+  char filename[64];
+  generate_filename(timestamp, filename, sizeof(filename));
+
+  cJSON *json = cJSON_CreateObject();
+  cJSON_AddStringToObject(json, "camNo", camNo);
+  cJSON_AddNumberToObject(json, "timestamp", (double)timestamp);
+  cJSON_AddStringToObject(json, "filename", filename);
+  cJSON_AddNumberToObject(json, "size", (double)size);
+  char *json_str = cJSON_PrintUnformatted(json);
+  cJSON_Delete(json);
+
+  if (!json_str)
+    return -1;
+
+  unsigned char length[4];
+  size_t json_len = strlen(json_str);
+  put_be32(length, (uint32_t)json_len);
+
+  int result = 0;
+  if (send_all(fd, length, sizeof(length)) != 0 || send_all(fd, json_str, json_len) != 0 ||
+      send_all(fd, data, size) != 0)
+    result = -1;
+
+  free(json_str);
+  return result;
+}
+
 // HELP FUNCTION
 void print_help(void)
 {
@@ -475,27 +1228,38 @@ void print_help(void)
   printf("   Example: ./samp.exe --post --file test/image.bmp --camera CAM0\n");
   printf("\n");
   printf("2. GET - Retrieve frames (with optional filters)\n");
-  printf("   ./samp.exe --get --camera <camera_name> [--year Y] [--month M] [--day D] [--hour H] [--minute MIN] [--second S]\n");
+  printf("   ./samp.exe --get --camera <camera_name> [--year Y] [--month M] [--day D] [--hour H] [--minute MIN] [--second S] [--ndjson | --columnar]\n");
   printf("   Examples:\n");
   printf("     ./samp.exe --get --camera CAM0                          (all frames)\n");
   printf("     ./samp.exe --get --camera CAM0 --year 2025             (specific year)\n");
   printf("     ./samp.exe --get --camera CAM0 --year 2025 --month 11 (specific month)\n");
   printf("     ./samp.exe --get --camera CAM0 --day 10                (specific day)\n");
   printf("     ./samp.exe --get --camera CAM0 --hour 12               (specific hour)\n");
+  printf("     ./samp.exe --get --camera CAM0 --year 2025 --ndjson    (streamed, no row cap)\n");
+  printf("     ./samp.exe --get --camera CAM0 --hour 12 --columnar    (compact binary columns)\n");
+  printf("     ./samp.exe --get --camera CAM0,CAM1 --hour 12           (cameras merged in time order)\n");
+  printf("   Nearest frame (image saved in one request):\n");
+  printf("   ./samp.exe --get --camera <camera_name> --at <epoch_ms | HH:MM:SS.mmm> [--dir before|after|nearest] [--output <path>]\n");
+  printf("     ./samp.exe --get --camera CAM0 --year 2025 --month 11 --day 10 --at 14:03:27.500\n");
   printf("\n");
   printf("3. DOWNLOAD - Download file by filename\n");
   printf("   ./samp.exe --download --filename <filename> [--output <output_path>]\n");
   printf("   Example: ./samp.exe --download --filename 251110123456_123.bmp\n");
   printf("   Example: ./samp.exe --download --filename 251110123456_123.bmp --output myfile.bmp\n");
   printf("\n");
-  printf("4. HELP - Show this message\n");
+  printf("4. STREAM - Send a BMP frame over the TCP ingest port (binary v2 header)\n");
+  printf("   ./samp.exe --stream --file <filepath> --camera <camera_name> [--host H] [--port P] [--count N] [--interval MS]\n");
+  printf("   Example: ./samp.exe --stream --file test/image.bmp --camera CAM0 --count 100 --interval 300\n");
+  printf("\n");
+  printf("5. HELP - Show this message\n");
   printf("   ./samp.exe --help\n");
   printf("\n");
   printf("NOTES:\n");
   printf("------\n");
-  printf("- Camera name is required for --post and --get\n");
+  printf("- Camera name is required for --post, --get and --stream\n");
   printf("- File path is required for --post\n");
   printf("- For --get: all filter parameters are optional. If none provided, returns all frames\n");
+  printf("- For --get: repeat --camera or give a comma-separated list to merge several cameras\n");
   printf("- Downloaded files are saved as 'downloaded_frame.bmp' by default\n");
   printf("- API server must be running on http://localhost:3005\n");
   printf("\n");
@@ -643,16 +1407,29 @@ int main(int argc, char *argv[])
   // Parse --get
   else if (strcmp(argv[1], "--get") == 0)
   {
-    char *camera = NULL;
+    QueryParams params = {0};
     int year = 0, month = 0, day = 0;
     int hour = -1, minute = -1, second = -1;
+    int ndjson = 0;
+    int columnar = 0;
+    const char *at = NULL;
+    const char *dir = "nearest";
+    const char *output_path = "nearest_frame.bmp";
 
     // Parse arguments
     for (int i = 2; i < argc; i++)
     {
       if (strcmp(argv[i], "--camera") == 0 && i + 1 < argc)
       {
-        camera = argv[++i];
+        // Repeat --camera (or give CAM0,CAM1) to merge several cameras
+        char *list = argv[++i];
+        for (char *cam = strtok(list, ","); cam; cam = strtok(NULL, ","))
+        {
+          if (params.camera_count < QUERY_MAX_CAMERAS)
+            params.cameras[params.camera_count++] = cam;
+          else
+            printf("WARNING: Ignoring camera %s (at most %d)\n", cam, QUERY_MAX_CAMERAS);
+        }
       }
       else if (strcmp(argv[i], "--year") == 0 && i + 1 < argc)
       {
@@ -678,18 +1455,59 @@ int main(int argc, char *argv[])
       {
         second = atoi(argv[++i]);
       }
+      else if (strcmp(argv[i], "--ndjson") == 0)
+      {
+        ndjson = 1;
+      }
+      else if (strcmp(argv[i], "--columnar") == 0)
+      {
+        columnar = 1;
+      }
+      else if (strcmp(argv[i], "--at") == 0 && i + 1 < argc)
+      {
+        at = argv[++i];
+      }
+      else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+      {
+        dir = argv[++i];
+      }
+      else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+      {
+        output_path = argv[++i];
+      }
     }
 
-    if (!camera)
+    if (params.camera_count == 0)
     {
       printf("ERROR: --get requires --camera argument\n");
-      printf("Usage: samp.exe --get --camera <camera_name> [--year Y] [--month M] [--day D] [--hour H] [--minute MIN] [--second S]\n");
+      printf("Usage: samp.exe --get --camera <camera_name> [--year Y] [--month M] [--day D] [--hour H] [--minute MIN] [--second S] [--ndjson | --columnar]\n");
       result = -1;
     }
+    else if (columnar && params.camera_count > 1)
+    {
+      printf("ERROR: --columnar takes a single --camera\n");
+      result = -1;
+    }
+    else if (at)
+    {
+      long long ts = parse_at_time(at, year, month, day);
+      if (ts < 0)
+      {
+        printf("ERROR: --at takes epoch ms, or HH:MM:SS[.mmm] with --year --month --day\n");
+        result = -1;
+      }
+      else if (params.camera_count > 1)
+      {
+        printf("ERROR: --at takes a single --camera\n");
+        result = -1;
+      }
+      else
+      {
+        result = imgDataGetAt(params.cameras[0], ts, dir, output_path);
+      }
+    }
     else
     {
-      QueryParams params;
-      params.camNo = camera;
       params.year = year;
       params.month = month;
       params.day = day;
@@ -697,7 +1515,12 @@ int main(int argc, char *argv[])
       params.minute = minute;
       params.second = second;
 
-      result = imgDataGet(params, imgData_g);
+      if (ndjson)
+        result = imgDataGetStream(params);
+      else if (columnar)
+        result = imgDataGetColumnar(params);
+      else
+        result = imgDataGet(params, imgData_g);
       if (result == 0)
       {
         printf("Frames metadata retrieved successfully.\n");
@@ -741,6 +1564,84 @@ int main(int argc, char *argv[])
       result = download_frame_file(filename, output_path);
     }
   }
+  // Parse --stream
+  else if (strcmp(argv[1], "--stream") == 0)
+  {
+    char *filepath = NULL;
+    char *camera = NULL;
+    const char *host = STREAM_DEFAULT_HOST;
+    const char *port = STREAM_DEFAULT_PORT;
+    int count = 1;
+    int interval_ms = 300;
+
+    // Parse arguments
+    for (int i = 2; i < argc; i++)
+    {
+      if (strcmp(argv[i], "--file") == 0 && i + 1 < argc)
+      {
+        filepath = argv[++i];
+      }
+      else if (strcmp(argv[i], "--camera") == 0 && i + 1 < argc)
+      {
+        camera = argv[++i];
+      }
+      else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc)
+      {
+        host = argv[++i];
+      }
+      else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+      {
+        port = argv[++i];
+      }
+      else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+      {
+        count = atoi(argv[++i]);
+      }
+      else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+      {
+        interval_ms = atoi(argv[++i]);
+      }
+    }
+
+    if (!filepath || !camera)
+    {
+      printf("ERROR: --stream requires --file and --camera arguments\n");
+      printf("Usage: samp.exe --stream --file <filepath> --camera <camera_name> [--host H] [--port P] [--count N] [--interval MS]\n");
+      result = -1;
+    }
+    else if (strlen(camera) > STREAM_CAMNO_MAX)
+    {
+      printf("ERROR: --camera must be at most %d bytes for streaming\n", STREAM_CAMNO_MAX);
+      result = -1;
+    }
+    else
+    {
+      size_t file_size;
+      unsigned char *bmp_data = load_bmp_file(filepath, &file_size);
+      int version = 1;
+      int fd = bmp_data ? stream_connect(host, port, &version) : -1;
+
+      if (fd >= 0)
+      {
+        result = 0;
+        for (int n = 0; n < count; n++)
+        {
+          if (stream_send_frame(fd, version, camera, get_current_timestamp_ms(), bmp_data, file_size) != 0)
+          {
+            printf("ERROR: Stream send failed after %d frames\n", n);
+            result = -1;
+            break;
+          }
+          if (n + 1 < count && interval_ms > 0)
+            usleep((useconds_t)interval_ms * 1000);
+        }
+        if (result == 0)
+          printf("Streamed %d frame(s) to %s:%s\n", count, host, port);
+        close(fd);
+      }
+      free(bmp_data);
+    }
+  }
   else
   {
     printf("ERROR: Unknown command: %s\n", argv[1]);
@@ -0,0 +1,142 @@
+// MJPEG-in-AVI container, written front to back
+//
+// header() goes out before any frame, so the sizes and counts it can't know
+// yet are 0: the RIFF and movi sizes, dwTotalFrames and dwLength. A movi list
+// of size 0 also leaves the idx1 chunk inside it as far as sizes go. Such a
+// streamed file plays in ffmpeg-based players (ffmpeg, VLC, mpv), which scan
+// the chunks; Windows Media Foundation and QuickTime reject it or show no
+// duration. When the output is seekable, write header(true) over the first
+// header() after trailer(): it is the same length and carries every size and
+// count, which gives a standard file all players accept.
+// idx1 lists every frame (16 bytes per frame are kept until the end; past
+// `maxIndexFrames` it is left out and players fall back to scanning).
+//   RIFF 'AVI '
+//     LIST 'hdrl'  avih, LIST 'strl' (strh 'vids'/'MJPG', strf BITMAPINFOHEADER)
+//     LIST 'movi'  '00dc' chunk per JPEG frame (padded to even size)
+//     idx1
+
+const AVIF_HASINDEX = 0x10;
+const AVIIF_KEYFRAME = 0x10;
+
+function chunk(fourcc, data) {
+	const head = Buffer.alloc(8);
+	head.write(fourcc, 0, 'latin1');
+	head.writeUInt32LE(data.length, 4);
+	return data.length & 1 ? Buffer.concat([head, data, Buffer.alloc(1)]) : Buffer.concat([head, data]);
+}
+
+function list(type, size, body = []) {
+	const head = Buffer.alloc(12);
+	head.write('LIST', 0, 'latin1');
+	head.writeUInt32LE(size, 4);
+	head.write(type, 8, 'latin1');
+	return Buffer.concat([head, ...body]);
+}
+
+// Frame size from a JPEG's SOFn marker, or null
+function jpegSize(jpeg) {
+	let pos = 2;
+	while (pos + 9 < jpeg.length && jpeg[pos] === 0xff) {
+		const marker = jpeg[pos + 1];
+		const length = jpeg.readUInt16BE(pos + 2);
+		if (marker >= 0xc0 && marker <= 0xcf && marker !== 0xc4 && marker !== 0xc8 && marker !== 0xcc) {
+			return { height: jpeg.readUInt16BE(pos + 5), width: jpeg.readUInt16BE(pos + 7) };
+		}
+		pos += 2 + length;
+	}
+	return null;
+}
+
+class AviWriter {
+	constructor({ width, height, fps, maxIndexFrames = 1 << 20 }) {
+		this.width = width;
+		this.height = height;
+		this.fps = fps;
+		this.maxIndexFrames = maxIndexFrames;
+		this.frames = 0;
+		this.moviOffset = 4; // next chunk's offset from the 'movi' fourcc, as idx1 counts it
+		this.index = [];
+	}
+
+	// final: sizes and counts of everything written so far, trailer included (see above)
+	header(final = false) {
+		const { width, height, fps } = this;
+		const frames = final ? this.frames : 0;
+
+		const avih = Buffer.alloc(56);
+		avih.writeUInt32LE(Math.round(1e6 / fps), 0); // dwMicroSecPerFrame
+		avih.writeUInt32LE(final && !this.index ? 0 : AVIF_HASINDEX, 12);
+		avih.writeUInt32LE(frames, 16); // dwTotalFrames
+		avih.writeUInt32LE(1, 24); // dwStreams
+		avih.writeUInt32LE(width * height * 3, 28); // dwSuggestedBufferSize
+		avih.writeUInt32LE(width, 32);
+		avih.writeUInt32LE(height, 36);
+
+		const strh = Buffer.alloc(56);
+		strh.write('vids', 0, 'latin1');
+		strh.write('MJPG', 4, 'latin1');
+		strh.writeUInt32LE(1, 20); // dwScale
+		strh.writeUInt32LE(fps, 24); // dwRate
+		strh.writeUInt32LE(frames, 32); // dwLength
+		strh.writeUInt32LE(width * height * 3, 36);
+		strh.writeInt32LE(-1, 40); // dwQuality: default
+		strh.writeInt16LE(width, 52); // rcFrame right
+		strh.writeInt16LE(height, 54); // rcFrame bottom
+
+		const strf = Buffer.alloc(40);
+		strf.writeUInt32LE(40, 0);
+		strf.writeInt32LE(width, 4);
+		strf.writeInt32LE(height, 8);
+		strf.writeUInt16LE(1, 12);
+		strf.writeUInt16LE(24, 14);
+		strf.write('MJPG', 16, 'latin1');
+		strf.writeUInt32LE(width * height * 3, 20);
+
+		const strl = [chunk('strh', strh), chunk('strf', strf)];
+		const strlSize = 4 + strl.reduce((n, b) => n + b.length, 0);
+		const hdrlBody = [chunk('avih', avih), list('strl', strlSize, strl)];
+		const hdrlSize = 4 + hdrlBody.reduce((n, b) => n + b.length, 0);
+
+		const riff = Buffer.alloc(12);
+		riff.write('RIFF', 0, 'latin1');
+		riff.write('AVI ', 8, 'latin1');
+		const hdrl = list('hdrl', hdrlSize, hdrlBody);
+		if (final) {
+			// 'AVI ' + hdrl + movi list (moviOffset counts from its fourcc) + idx1
+			const riffSize = 4 + hdrl.length + 8 + this.moviOffset + this.trailerSize();
+			riff.writeUInt32LE(Math.min(riffSize, 0xffffffff), 4);
+		}
+		return Buffer.concat([riff, hdrl, list('movi', final ? Math.min(this.moviOffset, 0xffffffff) : 0)]);
+	}
+
+	trailerSize() {
+		return this.index ? 8 + this.index.length * 8 : 0;
+	}
+
+	frame(jpeg) {
+		const out = chunk('00dc', jpeg);
+		if (this.index && this.frames < this.maxIndexFrames && this.moviOffset <= 0xffffffff) {
+			this.index.push(this.moviOffset, jpeg.length);
+		} else {
+			this.index = null;
+		}
+		this.moviOffset += out.length;
+		this.frames++;
+		return out;
+	}
+
+	trailer() {
+		if (!this.index) return Buffer.alloc(0);
+		const idx = Buffer.alloc(this.index.length * 8);
+		for (let i = 0; i < this.index.length; i += 2) {
+			const at = i * 8;
+			idx.write('00dc', at, 'latin1');
+			idx.writeUInt32LE(AVIIF_KEYFRAME, at + 4);
+			idx.writeUInt32LE(this.index[i], at + 8);
+			idx.writeUInt32LE(this.index[i + 1], at + 12);
+		}
+		return chunk('idx1', idx);
+	}
+}
+
+module.exports = { AviWriter, jpegSize };
@@ -0,0 +1,79 @@
+// Clip export: one camera's frames over a time range as a single streamed file
+//
+// Rows come in index order (a PagedScan through mergeFrames, see frameMerge.js).
+// Up to `readAhead` frames are read and JPEG-encoded on the image workers at
+// once, and they are written strictly in row order as each one completes. A
+// write waits for the response to drain and no new frame is started until
+// then, so memory stays at about `readAhead` frames however long the clip is.
+//   avi    MJPEG-in-AVI (aviWriter.js); header sized from the first frame, and
+//          finalized for outputs that can be patched afterwards
+//   mjpeg  the JPEGs back to back
+
+const { AviWriter, jpegSize } = require('./aviWriter');
+
+const EXPORT_FORMATS = ['avi', 'mjpeg'];
+
+// rows: async iterable of tb_index rows. encode(row) -> Promise<Buffer> (JPEG);
+// write(buf) -> Promise resolved once the output can take more; isOpen() false stops the export;
+// onSkip(row, err) reports a frame left out. Resolves { frames, skipped, bytes, header }; for a
+// completed avi, header is the finalized AVI header to write over the start (seekable outputs only).
+async function exportClip(rows, { format, fps, encode, write, isOpen, onSkip, readAhead = 8 }) {
+	const source = rows[Symbol.asyncIterator]();
+	const pending = []; // Promise<{ row, jpeg } | { row, err }> in row order
+	let exhausted = false;
+	let avi = null;
+	let frames = 0;
+	let skipped = 0;
+	let bytes = 0;
+
+	const put = async (buf) => {
+		bytes += buf.length;
+		await write(buf);
+	};
+
+	while (isOpen()) {
+		while (!exhausted && pending.length < readAhead) {
+			const { value: row, done } = await source.next();
+			if (done) {
+				exhausted = true;
+				break;
+			}
+			pending.push(
+				encode(row).then(
+					(jpeg) => ({ row, jpeg }),
+					(err) => ({ row, err })
+				)
+			);
+		}
+		if (pending.length === 0) break;
+
+		const { row, jpeg, err } = await pending.shift();
+		if (!isOpen()) break;
+		const size = jpeg && format === 'avi' && !avi ? jpegSize(jpeg) : null;
+		if (err || (format === 'avi' && !avi && !size)) {
+			skipped++;
+			onSkip(row, err || new Error('Unreadable JPEG'));
+			continue;
+		}
+
+		if (format === 'avi') {
+			if (!avi) {
+				avi = new AviWriter({ width: size.width, height: size.height, fps });
+				await put(avi.header());
+			}
+			await put(avi.frame(jpeg));
+		} else {
+			await put(jpeg);
+		}
+		frames++;
+	}
+
+	let header = null;
+	if (avi && isOpen()) {
+		await put(avi.trailer());
+		header = avi.header(true);
+	}
+	return { frames, skipped, bytes, header };
+}
+
+module.exports = { exportClip, EXPORT_FORMATS };
@@ -0,0 +1,188 @@
+// Columnar encoding of GET /api/frames results (format=columnar)
+//
+// A result set holds a single camNo, so rows reduce to two columns: a
+// timestamp and a location. Timestamps are wall-clock milliseconds, i.e. the
+// local tb_index fields read as UTC (Date.UTC(t_year, t_mon - 1, ...)), so
+// they round-trip to the stored fields with UTC getters and never jump at DST.
+// They are sent as deltas from `baseTs`. Locations are almost always derived
+// from the timestamp, so they collapse into a small dictionary of templates:
+//   {ts}   yyMMddhhmmss_mmm of the row's own timestamp
+//   {sub}  the row's 3-digit sub-millisecond part (camera_service names use
+//          microseconds); only sent when some template uses it
+// A location the timestamp can't explain becomes its own literal entry.
+//
+// Binary form (little-endian, every section 4-byte aligned, jumps 8-aligned):
+//   0   u32 magic 'SVCF'
+//   4   u16 version (1)
+//   6   u16 flags (COLUMNAR_HAS_SUB)
+//   8   u32 row count N
+//   12  u32 template count D
+//   16  u32 jump count J
+//   20  u16 camNo byte length, u16 reserved
+//   24  f64 baseTs
+//   32  f64 jumps[J]          absolute ts of each row whose delta is JUMP_DELTA
+//   ..  camNo bytes, then D x (u16 byte length + UTF-8 template), pad to 4
+//   ..  u32 tsDelta[N]        ms since the previous row (row 0: since baseTs)
+//   ..  u16 locationIds[N], pad to 4
+//   ..  u16 sub[N], pad to 4  (only with COLUMNAR_HAS_SUB)
+
+const COLUMNAR_MAGIC = 0x46435653; // 'SVCF' little-endian
+const COLUMNAR_VERSION = 1;
+const COLUMNAR_HAS_SUB = 1;
+const COLUMNAR_HEADER_SIZE = 32;
+const JUMP_DELTA = 0xffffffff; // gap too large for u32: take the next jumps[] entry
+const MAX_TEMPLATES = 0xffff;
+
+const pad2 = (n) => String(n).padStart(2, '0');
+const pad4 = (n) => (n + 3) & ~3;
+
+function rowTs(r) {
+	return Date.UTC(r.t_year, r.t_mon - 1, r.t_mday, r.t_hour, r.t_min, r.t_sec, r.t_mill);
+}
+
+// Same stem as makeFilenameFromTimestamp(), from wall-clock ms
+function stemFromTs(ts) {
+	const d = new Date(ts);
+	return (
+		pad2(d.getUTCFullYear() % 100) +
+		pad2(d.getUTCMonth() + 1) +
+		pad2(d.getUTCDate()) +
+		pad2(d.getUTCHours()) +
+		pad2(d.getUTCMinutes()) +
+		pad2(d.getUTCSeconds()) +
+		'_' +
+		String(d.getUTCMilliseconds()).padStart(3, '0')
+	);
+}
+
+// { template, sub } for one location; the template is the location itself when nothing derives
+function templateFor(location, ts) {
+	const stem = stemFromTs(ts);
+	const at = location.lastIndexOf(stem);
+	if (at < 0 || location.includes('{')) return { template: location, sub: 0 };
+
+	const head = location.slice(0, at) + '{ts}';
+	const rest = location.slice(at + stem.length);
+	const micro = /^(\d{3})(?!\d)/.exec(rest);
+	if (micro) return { template: head + '{sub}' + rest.slice(3), sub: Number(micro[1]) };
+	return { template: head + rest, sub: 0 };
+}
+
+// rows: ordered tb_index rows of one camera (as returned by buildFramesQuery SQL)
+function toColumns(camNo, rows) {
+	const n = rows.length;
+	const tsDelta = new Array(n);
+	const locationIds = new Array(n);
+	const sub = new Array(n);
+	const templates = [];
+	const ids = new Map();
+	const jumps = [];
+	let hasSub = false;
+
+	const baseTs = n ? rowTs(rows[0]) : 0;
+	let prev = baseTs;
+	for (let i = 0; i < n; i++) {
+		const ts = rowTs(rows[i]);
+		const delta = ts - prev;
+		if (delta >= 0 && delta < JUMP_DELTA) {
+			tsDelta[i] = delta;
+		} else {
+			tsDelta[i] = JUMP_DELTA;
+			jumps.push(ts);
+		}
+		prev = ts;
+
+		const t = templateFor(String(rows[i].l_location), ts);
+		let id = ids.get(t.template);
+		if (id === undefined) {
+			if (templates.length >= MAX_TEMPLATES) throw new Error('Too many distinct locations for columnar format');
+			id = templates.length;
+			ids.set(t.template, id);
+			templates.push(t.template);
+			if (t.template.includes('{sub}')) hasSub = true;
+		}
+		locationIds[i] = id;
+		sub[i] = t.sub;
+	}
+
+	return { camNo, count: n, baseTs, tsDelta, jumps, templates, locationIds, sub: hasSub ? sub : null };
+}
+
+// JSON body; jumps are unnecessary there, so tsDelta holds plain deltas
+function toColumnarJson(columns) {
+	let j = 0;
+	let prev = columns.baseTs;
+	const tsDelta = columns.tsDelta.map((d) => {
+		const ts = d === JUMP_DELTA ? columns.jumps[j++] : prev + d;
+		const delta = ts - prev;
+		prev = ts;
+		return delta;
+	});
+	const body = {
+		format: 'columnar',
+		camNo: columns.camNo,
+		count: columns.count,
+		baseTs: columns.baseTs,
+		tsDelta,
+		templates: columns.templates,
+		locationIds: columns.locationIds,
+	};
+	if (columns.sub) body.sub = columns.sub;
+	return body;
+}
+
+function toColumnarBuffer(columns) {
+	const { count: n, templates, jumps } = columns;
+	const camNo = Buffer.from(columns.camNo, 'utf8');
+	const encoded = templates.map((t) => Buffer.from(t, 'utf8'));
+	const flags = columns.sub ? COLUMNAR_HAS_SUB : 0;
+
+	const jumpsAt = COLUMNAR_HEADER_SIZE;
+	const dictAt = jumpsAt + jumps.length * 8;
+	const dictBytes = camNo.length + encoded.reduce((sum, b) => sum + 2 + b.length, 0);
+	const deltasAt = pad4(dictAt + dictBytes);
+	const idsAt = deltasAt + n * 4;
+	const subAt = pad4(idsAt + n * 2);
+	const size = flags ? pad4(subAt + n * 2) : subAt;
+
+	const buf = Buffer.alloc(size);
+	buf.writeUInt32LE(COLUMNAR_MAGIC, 0);
+	buf.writeUInt16LE(COLUMNAR_VERSION, 4);
+	buf.writeUInt16LE(flags, 6);
+	buf.writeUInt32LE(n, 8);
+	buf.writeUInt32LE(templates.length, 12);
+	buf.writeUInt32LE(jumps.length, 16);
+	buf.writeUInt16LE(camNo.length, 20);
+	buf.writeDoubleLE(columns.baseTs, 24);
+
+	jumps.forEach((ts, i) => buf.writeDoubleLE(ts, jumpsAt + i * 8));
+
+	let off = dictAt + camNo.copy(buf, dictAt);
+	for (const b of encoded) {
+		buf.writeUInt16LE(b.length, off);
+		off += 2 + b.copy(buf, off + 2);
+	}
+
+	for (let i = 0; i < n; i++) {
+		buf.writeUInt32LE(columns.tsDelta[i], deltasAt + i * 4);
+		buf.writeUInt16LE(columns.locationIds[i], idsAt + i * 2);
+		if (flags) buf.writeUInt16LE(columns.sub[i], subAt + i * 2);
+	}
+	return buf;
+}
+
+// Cached query results are shared arrays: encode each one once per format
+const encodings = new WeakMap(); // rows -> { json, binary }
+
+function encodeColumnar(camNo, rows, binary) {
+	let cached = encodings.get(rows);
+	if (!cached) {
+		cached = { columns: toColumns(camNo, rows) };
+		encodings.set(rows, cached);
+	}
+	const key = binary ? 'binary' : 'json';
+	if (!cached[key]) cached[key] = binary ? toColumnarBuffer(cached.columns) : toColumnarJson(cached.columns);
+	return cached[key];
+}
+
+module.exports = { encodeColumnar, stemFromTs, COLUMNAR_MAGIC, COLUMNAR_VERSION };
@@ -0,0 +1,87 @@
+// Time-lapse contact sheets: N frames spread evenly over a time range, one image grid
+//
+// The range is cut into N equal slots and each slot is filled with its first
+// frame, found by one index seek (buildNearestQuery dir=after), so picking
+// frames costs N LIMIT 1 queries whatever the range. Slots without footage
+// stay black. Tiles are scaled on worker threads (imageWorker.js op 'tile');
+// composeContactSheet() only copies rows into the grid.
+
+const { buildNearestQuery } = require('./framesQuery');
+const { makeBmpHeader } = require('./frameFormat');
+
+const SHEET_MAX_FRAMES = 100;
+const SHEET_DEFAULT_FRAMES = 24;
+const SHEET_DEFAULT_TILE_WIDTH = 160;
+
+// Returns { camNo, start, end, n, width, format, slots, key, matches } or { error }
+// Query options:
+//  - camNo, start & end (epoch ms) required
+//  - n: frames (default 24, max 100), w: tile width in pixels (default 160), format: bmp | jpeg
+function buildContactSheetQuery(q) {
+	if (!q.camNo) return { error: 'camNo is required' };
+	const start = Number(q.start);
+	const end = Number(q.end);
+	if (!q.start || !q.end || !Number.isFinite(start) || !Number.isFinite(end)) {
+		return { error: 'start & end (epoch ms) are required' };
+	}
+	if (!(end > start)) return { error: 'Empty time range' };
+	const n = q.n ? Number(q.n) : SHEET_DEFAULT_FRAMES;
+	if (!Number.isInteger(n) || n < 1 || n > SHEET_MAX_FRAMES) return { error: `n must be 1-${SHEET_MAX_FRAMES}` };
+	const width = q.w ? Number(q.w) : SHEET_DEFAULT_TILE_WIDTH;
+	if (!Number.isInteger(width) || width < 16 || width > 640) return { error: 'w must be 16-640' };
+	const format = q.format ? String(q.format) : 'bmp';
+	if (format !== 'bmp' && format !== 'jpeg') return { error: 'format must be bmp or jpeg' };
+
+	const camNo = String(q.camNo);
+	const step = (end - start) / n;
+	const slots = [];
+	for (let i = 0; i < n; i++) {
+		const from = Math.floor(start + i * step);
+		const to = Math.floor(start + (i + 1) * step);
+		slots.push({ from, to, seek: buildNearestQuery({ camNo, ts: String(from), dir: 'after' }).seeks[0] });
+	}
+
+	return {
+		camNo,
+		start,
+		end,
+		n,
+		width,
+		format,
+		slots,
+		key: `${camNo}|sheet:${start}-${end}:${n}:${width}:${format}`,
+		matches: (rowCamNo, date) => rowCamNo === camNo && date.getTime() >= start && date.getTime() < end,
+	};
+}
+
+// tiles: top-down 24-bit BMPs (or null for an empty slot) -> one top-down BMP grid.
+// Cells are as large as the largest tile; smaller tiles sit centered.
+function composeContactSheet(tiles) {
+	const dims = tiles.map((t) => (t ? [t.readInt32LE(18), Math.abs(t.readInt32LE(22))] : [0, 0]));
+	const cellW = Math.max(1, ...dims.map((d) => d[0]));
+	const cellH = Math.max(1, ...dims.map((d) => d[1]));
+	const cols = Math.ceil(Math.sqrt(tiles.length));
+	const rows = Math.ceil(tiles.length / cols);
+
+	const width = cols * cellW;
+	const height = rows * cellH;
+	const stride = (width * 3 + 3) & ~3;
+	const pixels = Buffer.alloc(stride * height);
+
+	tiles.forEach((tile, i) => {
+		if (!tile) return;
+		const [w, h] = dims[i];
+		const tileStride = (w * 3 + 3) & ~3;
+		const offset = tile.readUInt32LE(10);
+		const x0 = (i % cols) * cellW + ((cellW - w) >> 1);
+		const y0 = Math.floor(i / cols) * cellH + ((cellH - h) >> 1);
+		for (let y = 0; y < h; y++) {
+			const src = offset + y * tileStride;
+			tile.copy(pixels, (y0 + y) * stride + x0 * 3, src, src + w * 3);
+		}
+	});
+
+	return { bmp: Buffer.concat([makeBmpHeader(width, height, pixels.length), pixels]), cols, rows, cellW, cellH };
+}
+
+module.exports = { buildContactSheetQuery, composeContactSheet, SHEET_MAX_FRAMES };
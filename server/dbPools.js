@@ -0,0 +1,210 @@
+// MariaDB pools: a pinned writer pool for the index batcher, a small
+// analysis pool for background writers (motion scores, heatmaps, hashes) so
+// they never take a batcher connection, and a bounded reader pool shared by
+// API queries and playback.
+//
+// Reader connections are handed out through a priority gate, so a burst of
+// playback prefetches queues behind interactive queries instead of holding
+// every connection, and can never take the writer's. Use withConnection(),
+// which releases the connection (and the gate slot) when `fn` settles.
+
+const mariadb = require('mariadb');
+
+const PRIORITIES = ['interactive', 'prefetch']; // highest first
+
+class PriorityGate {
+	constructor(limit, queueTimeoutMs) {
+		this.limit = limit;
+		this.queueTimeoutMs = queueTimeoutMs;
+		this.active = 0;
+		this.queues = PRIORITIES.map(() => []);
+	}
+
+	acquire(priority) {
+		if (this.active < this.limit) {
+			this.active++;
+			return Promise.resolve();
+		}
+		return new Promise((resolve, reject) => {
+			const waiter = { resolve, timer: null };
+			const queue = this.queues[priority];
+			waiter.timer = setTimeout(() => {
+				queue.splice(queue.indexOf(waiter), 1);
+				reject(new Error(`Reader queue timeout (${PRIORITIES[priority]})`));
+			}, this.queueTimeoutMs);
+			queue.push(waiter);
+		});
+	}
+
+	release() {
+		for (const queue of this.queues) {
+			const waiter = queue.shift();
+			if (waiter) {
+				clearTimeout(waiter.timer);
+				waiter.resolve(); // slot passes straight to the waiter
+				return;
+			}
+		}
+		this.active--;
+	}
+}
+
+function createDbPools({
+	host,
+	port,
+	user,
+	password,
+	database,
+	writerConnections,
+	analysisConnections,
+	readerConnections,
+	acquireTimeout,
+	registry,
+}) {
+	const base = { host, port, user, password, database, acquireTimeout };
+
+	// minimumIdle keeps the writer's connections open, so a flush never waits on a handshake
+	const writerPool = mariadb.createPool({
+		...base,
+		connectionLimit: writerConnections,
+		minimumIdle: writerConnections,
+	});
+	const analysisPool = mariadb.createPool({ ...base, connectionLimit: analysisConnections });
+	const readerPool = mariadb.createPool({ ...base, connectionLimit: readerConnections });
+	const gate = new PriorityGate(readerConnections, acquireTimeout);
+
+	const waitHistogram = registry.histogram(
+		'surveillance_db_pool_wait_seconds',
+		'Time spent waiting for a pool connection',
+		['pool', 'priority'],
+		[0.001, 0.005, 0.01, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 20]
+	);
+	const writerWait = waitHistogram.labels('writer', 'write');
+	const analysisWait = waitHistogram.labels('analysis', 'write');
+	const readerWait = PRIORITIES.map((p) => waitHistogram.labels('reader', p));
+
+	registry.gauge('surveillance_db_pool_waiting', 'Requests queued for a pool connection', ['pool', 'priority'], (g) => {
+		g.labels('writer', 'write').set(writerPool.taskQueueSize());
+		g.labels('analysis', 'write').set(analysisPool.taskQueueSize());
+		PRIORITIES.forEach((p, i) => g.labels('reader', p).set(gate.queues[i].length));
+	});
+	registry.gauge('surveillance_db_pool_active', 'Pool connections in use', ['pool'], (g) => {
+		g.labels('writer').set(writerPool.activeConnections());
+		g.labels('analysis').set(analysisPool.activeConnections());
+		g.labels('reader').set(gate.active);
+	});
+
+	const writePool = (pool, wait) => ({
+		async withConnection(fn) {
+			const start = process.hrtime.bigint();
+			const conn = await pool.getConnection();
+			wait.observe(Number(process.hrtime.bigint() - start) / 1e9);
+			try {
+				return await fn(conn);
+			} finally {
+				conn.release();
+			}
+		},
+	});
+
+	return {
+		writer: writePool(writerPool, writerWait),
+		analysis: writePool(analysisPool, analysisWait),
+
+		reader: {
+			// priority: 'interactive' (someone is waiting) or 'prefetch' (read-ahead)
+			async withConnection(priority, fn) {
+				const p = Math.max(0, PRIORITIES.indexOf(priority));
+				const start = process.hrtime.bigint();
+				await gate.acquire(p);
+				let conn;
+				try {
+					conn = await readerPool.getConnection();
+					readerWait[p].observe(Number(process.hrtime.bigint() - start) / 1e9);
+					return await fn(conn);
+				} finally {
+					if (conn) conn.release();
+					gate.release();
+				}
+			},
+		},
+
+		async end() {
+			await Promise.all([writerPool.end(), analysisPool.end(), readerPool.end()]);
+		},
+	};
+}
+
+// Streaming read cursor held on one reader connection (conn.queryStream).
+// Rows are pushed to onRow as they arrive; pause()/resume() apply
+// backpressure to the socket. close() stops early: the connector skips the
+// rest of the result, and the connection goes back to the pool (and the gate)
+// once that skip has drained, so onClose may run some time after close().
+// onClose(err, completed) runs once; completed is true when the result ran out.
+class QueryCursor {
+	constructor(reader, priority, sql, params, { onRow, onClose }) {
+		this.reader = reader;
+		this.priority = priority;
+		this.sql = sql;
+		this.params = params;
+		this.onRow = onRow;
+		this.onClose = onClose;
+		this.stream = null;
+		this.paused = false;
+		this.closed = false;
+		this.reported = false;
+	}
+
+	open() {
+		this.reader
+			.withConnection(
+				this.priority,
+				(conn) =>
+					new Promise((resolve, reject) => {
+						if (this.closed) return resolve(false);
+						const stream = conn.queryStream(this.sql, this.params);
+						this.stream = stream;
+						if (this.paused) stream.pause();
+						stream.on('data', (row) => {
+							if (!this.closed) this.onRow(row);
+						});
+						// The connection (and its gate slot) goes back only once the
+						// stream is done, including the skip after close()
+						stream.on('error', reject);
+						stream.on('end', () => resolve(true));
+						stream.on('close', () => resolve(false));
+					})
+			)
+			.then(
+				(completed) => this.report(null, completed),
+				(err) => this.report(this.closed ? null : err, false)
+			);
+	}
+
+	pause() {
+		this.paused = true;
+		if (this.stream) this.stream.pause();
+	}
+
+	resume() {
+		this.paused = false;
+		if (this.stream) this.stream.resume();
+	}
+
+	close() {
+		if (this.closed || this.reported) return;
+		this.closed = true;
+		if (this.stream) {
+			this.stream.close();
+			this.stream.resume(); // let the skip drain; 'end' or 'close' releases the connection
+		}
+	}
+
+	report(err, completed) {
+		if (this.reported) return;
+		this.reported = true;
+		this.onClose(err, completed && !this.closed);
+	}
+}
+
+module.exports = { createDbPools, QueryCursor };
@@ -0,0 +1,242 @@
+// Frame pixel formats and on-demand BMP synthesis
+//
+// Cameras may send finished BMP files or raw pixel planes. Raw frames are
+// stored as-is in a .raw file with a 16-byte little-endian prefix:
+//   0   u32 magic 'SVRW'
+//   4   u16 codec (CODEC_*)
+//   6   u16 width
+//   8   u16 height
+//   10  u16 reserved
+//   12  u32 stride (bytes per source row)
+// A BMP header (or any other container) is only built when a reader needs it.
+
+const CODEC_BMP = 0;
+const CODEC_BGR24 = 1;
+const CODEC_YUYV = 2;
+
+const CODEC_NAMES = { bmp: CODEC_BMP, bgr24: CODEC_BGR24, yuyv: CODEC_YUYV };
+
+const RAW_MAGIC = 0x57525653; // 'SVRW' little-endian
+const RAW_HEADER_SIZE = 16;
+const BMP_HEADER_SIZE = 54;
+
+function isRawCodec(codec) {
+	return codec === CODEC_BGR24 || codec === CODEC_YUYV;
+}
+
+function codecFromName(name) {
+	return Object.prototype.hasOwnProperty.call(CODEC_NAMES, name) ? CODEC_NAMES[name] : null;
+}
+
+function bytesPerPixel(codec) {
+	return codec === CODEC_YUYV ? 2 : 3;
+}
+
+// Validate a { codec, width, height, stride } description against the payload size
+function checkPixelFormat(format, size) {
+	const { codec, width, height, stride } = format;
+	if (!isRawCodec(codec)) return `Unsupported codec ${codec}`;
+	if (!(width > 0 && height > 0 && width <= 0xffff && height <= 0xffff)) {
+		return `Bad frame dimensions ${width}x${height}`;
+	}
+	if (stride < width * bytesPerPixel(codec)) return `Stride ${stride} too small for width ${width}`;
+	if (size < stride * (height - 1) + width * bytesPerPixel(codec)) return `Frame truncated (${size} bytes)`;
+	return null;
+}
+
+function rawFileName(filename) {
+	return filename.replace(/\.[^./\\]*$/, '') + '.raw';
+}
+
+function isRawFile(filePath) {
+	return filePath.endsWith('.raw');
+}
+
+function makeRawHeader({ codec, width, height, stride }) {
+	const header = Buffer.alloc(RAW_HEADER_SIZE);
+	header.writeUInt32LE(RAW_MAGIC, 0);
+	header.writeUInt16LE(codec, 4);
+	header.writeUInt16LE(width, 6);
+	header.writeUInt16LE(height, 8);
+	header.writeUInt32LE(stride, 12);
+	return header;
+}
+
+// Returns { format, pixels } or null when the buffer is not a raw frame file
+function parseRawFile(buf) {
+	if (buf.length < RAW_HEADER_SIZE || buf.readUInt32LE(0) !== RAW_MAGIC) return null;
+	return {
+		format: {
+			codec: buf.readUInt16LE(4),
+			width: buf.readUInt16LE(6),
+			height: buf.readUInt16LE(8),
+			stride: buf.readUInt32LE(12),
+		},
+		pixels: buf.subarray(RAW_HEADER_SIZE),
+	};
+}
+
+function makeBmpHeader(width, height, imageSize) {
+	const header = Buffer.alloc(BMP_HEADER_SIZE);
+	header.write('BM', 0, 'latin1');
+	header.writeUInt32LE(BMP_HEADER_SIZE + imageSize, 2);
+	header.writeUInt32LE(BMP_HEADER_SIZE, 10);
+	header.writeUInt32LE(40, 14); // BITMAPINFOHEADER
+	header.writeInt32LE(width, 18);
+	header.writeInt32LE(-height, 22); // negative height: rows stored top-down, no reordering
+	header.writeUInt16LE(1, 26);
+	header.writeUInt16LE(24, 28);
+	header.writeUInt32LE(imageSize, 34);
+	return header;
+}
+
+function clamp8(v) {
+	return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+// YUYV 4:2:2 -> BGR24 rows padded to bmpStride (BT.601, integer math)
+function yuyvToBgr(pixels, width, height, stride, bmpStride) {
+	const out = Buffer.alloc(bmpStride * height);
+	for (let y = 0; y < height; y++) {
+		let src = y * stride;
+		let dst = y * bmpStride;
+		for (let x = 0; x < width; x += 2, src += 4) {
+			const u = pixels[src + 1] - 128;
+			const v = pixels[src + 3] - 128;
+			const rd = (359 * v) >> 8;
+			const gd = (88 * u + 183 * v) >> 8;
+			const bd = (454 * u) >> 8;
+			for (let k = 0; k < 2 && x + k < width; k++) {
+				const luma = pixels[src + k * 2];
+				out[dst++] = clamp8(luma + bd);
+				out[dst++] = clamp8(luma - gd);
+				out[dst++] = clamp8(luma + rd);
+			}
+		}
+	}
+	return out;
+}
+
+// BMP for a raw frame as [header, pixelData]; pixel data is the original
+// buffer when the source stride already matches BMP row padding.
+function bmpParts(format, pixels) {
+	const { codec, width, height, stride } = format;
+	const bmpStride = (width * 3 + 3) & ~3;
+	const imageSize = bmpStride * height;
+
+	let data;
+	if (codec === CODEC_YUYV) {
+		data = yuyvToBgr(pixels, width, height, stride, bmpStride);
+	} else if (stride === bmpStride) {
+		data = pixels.subarray(0, imageSize);
+	} else {
+		data = Buffer.alloc(imageSize);
+		for (let y = 0; y < height; y++) {
+			pixels.copy(data, y * bmpStride, y * stride, y * stride + width * 3);
+		}
+	}
+
+	return [makeBmpHeader(width, height, imageSize), data];
+}
+
+// 24-bit BMP scaled down by an integer factor (box average), written top-down.
+// Returns null for anything but an uncompressed 24-bit BMP.
+function downscaleBmp(bmp, factor) {
+	if (bmp.length < BMP_HEADER_SIZE || bmp.toString('latin1', 0, 2) !== 'BM') return null;
+	if (bmp.readUInt16LE(28) !== 24 || bmp.readUInt32LE(30) !== 0) return null;
+
+	const offset = bmp.readUInt32LE(10);
+	const width = bmp.readInt32LE(18);
+	const rawHeight = bmp.readInt32LE(22);
+	const height = Math.abs(rawHeight);
+	const topDown = rawHeight < 0;
+	const stride = (width * 3 + 3) & ~3;
+	if (width <= 0 || offset + stride * height > bmp.length) return null;
+
+	const outWidth = Math.max(1, Math.floor(width / factor));
+	const outHeight = Math.max(1, Math.floor(height / factor));
+	const outStride = (outWidth * 3 + 3) & ~3;
+	const out = Buffer.alloc(outStride * outHeight);
+	const area = factor * factor;
+
+	for (let y = 0; y < outHeight; y++) {
+		for (let x = 0; x < outWidth; x++) {
+			let b = 0;
+			let g = 0;
+			let r = 0;
+			for (let dy = 0; dy < factor; dy++) {
+				const row = y * factor + dy;
+				let src = offset + (topDown ? row : height - 1 - row) * stride + x * factor * 3;
+				for (let dx = 0; dx < factor; dx++, src += 3) {
+					b += bmp[src];
+					g += bmp[src + 1];
+					r += bmp[src + 2];
+				}
+			}
+			const dst = y * outStride + x * 3;
+			out[dst] = b / area;
+			out[dst + 1] = g / area;
+			out[dst + 2] = r / area;
+		}
+	}
+
+	return Buffer.concat([makeBmpHeader(outWidth, outHeight, out.length), out]);
+}
+
+// Mean luma (BT.601) of each cell of a cols x rows grid over a 24-bit BMP, top row first.
+// At most `samples` x `samples` pixels per cell are read. Returns null for other BMPs.
+function lumaGrid(bmp, cols, rows, samples = 16) {
+	if (bmp.length < BMP_HEADER_SIZE || bmp.toString('latin1', 0, 2) !== 'BM') return null;
+	if (bmp.readUInt16LE(28) !== 24 || bmp.readUInt32LE(30) !== 0) return null;
+
+	const offset = bmp.readUInt32LE(10);
+	const width = bmp.readInt32LE(18);
+	const rawHeight = bmp.readInt32LE(22);
+	const height = Math.abs(rawHeight);
+	const stride = (width * 3 + 3) & ~3;
+	if (width < cols || height < rows || offset + stride * height > bmp.length) return null;
+
+	const stepX = Math.max(1, Math.floor(width / (cols * samples)));
+	const stepY = Math.max(1, Math.floor(height / (rows * samples)));
+	const sums = new Float64Array(cols * rows);
+	const counts = new Uint32Array(cols * rows);
+	for (let y = 0; y < height; y += stepY) {
+		const cellRow = Math.floor((y * rows) / height) * cols;
+		const line = offset + (rawHeight < 0 ? y : height - 1 - y) * stride;
+		for (let x = 0; x < width; x += stepX) {
+			const cell = cellRow + Math.floor((x * cols) / width);
+			const p = line + x * 3;
+			sums[cell] += 0.114 * bmp[p] + 0.587 * bmp[p + 1] + 0.299 * bmp[p + 2];
+			counts[cell]++;
+		}
+	}
+
+	const grid = new Uint8Array(cols * rows);
+	for (let i = 0; i < grid.length; i++) grid[i] = Math.round(sums[i] / counts[i]);
+	return grid;
+}
+
+// Any stored frame file (BMP or raw) as a complete BMP buffer
+function frameFileToBmp(fileBuffer) {
+	const raw = parseRawFile(fileBuffer);
+	if (!raw) return fileBuffer;
+	return Buffer.concat(bmpParts(raw.format, raw.pixels));
+}
+
+module.exports = {
+	CODEC_BMP,
+	CODEC_BGR24,
+	CODEC_YUYV,
+	isRawCodec,
+	codecFromName,
+	checkPixelFormat,
+	rawFileName,
+	isRawFile,
+	makeRawHeader,
+	makeBmpHeader,
+	parseRawFile,
+	bmpParts,
+	downscaleBmp,
+	lumaGrid,
+	frameFileToBmp,
+};
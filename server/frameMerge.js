@@ -0,0 +1,154 @@
+// Multi-camera /api/frames: per-camera index scans merged in timestamp order
+//
+// Each camera is read by a PagedScan: keyset pages of `pageSize` rows, each
+// page a short query on its own reader connection, with the next page
+// prefetched while the current one drains. The scans run in parallel but
+// never hold a connection between pages, so any number of cameras can be
+// merged through the bounded reader pool. mergeFrames() is an async
+// generator doing a k-way merge over the scans with a binary min-heap keyed
+// on (row time, camNo); memory stays at about two pages per camera.
+
+// Comparable row time: the tb_index fields as one number (wall-clock ms)
+function rowTime(r) {
+	return Date.UTC(r.t_year, r.t_mon - 1, r.t_mday, r.t_hour, r.t_min, r.t_sec, r.t_mill);
+}
+
+class MinHeap {
+	constructor(less) {
+		this.less = less;
+		this.items = [];
+	}
+
+	get size() {
+		return this.items.length;
+	}
+
+	push(item) {
+		const a = this.items;
+		a.push(item);
+		let i = a.length - 1;
+		while (i > 0) {
+			const parent = (i - 1) >> 1;
+			if (!this.less(a[i], a[parent])) break;
+			[a[i], a[parent]] = [a[parent], a[i]];
+			i = parent;
+		}
+	}
+
+	pop() {
+		const a = this.items;
+		const top = a[0];
+		const last = a.pop();
+		if (a.length > 0) {
+			a[0] = last;
+			let i = 0;
+			for (;;) {
+				const l = 2 * i + 1;
+				const r = l + 1;
+				let m = i;
+				if (l < a.length && this.less(a[l], a[m])) m = l;
+				if (r < a.length && this.less(a[r], a[m])) m = r;
+				if (m === i) break;
+				[a[i], a[m]] = [a[m], a[i]];
+				i = m;
+			}
+		}
+		return top;
+	}
+}
+
+// fetchPage(bound, limit): rows of one camera in time order, where bound is
+//   {}                 from the start, at most `limit`
+//   { after: row }     strictly after row's time, at most `limit`
+//   { at: row }        every row at exactly row's time, ordered by l_location
+// Timestamps are not unique, so a full page may stop partway through the rows
+// sharing its last time. Those rows are dropped from the page and re-read
+// whole with { at }, and the next page starts strictly after that time: the
+// keyset is (time, l_location) and no row is repeated or skipped, while the
+// page queries keep the index order (no tiebreaker column in their ORDER BY).
+class PagedScan {
+	constructor(fetchPage, pageSize) {
+		this.fetchPage = fetchPage;
+		this.pageSize = pageSize;
+		this.rows = [];
+		this.pos = 0;
+		this.done = false;
+		this.pending = null;
+		this.error = null; // failure of a background page, thrown from the next head()
+		this.last = null; // last row fetched; every row at its time has been fetched
+	}
+
+	// Start the next page now unless one is in flight or the scan has ended.
+	// The returned promise never rejects: a caller may have stopped reading, so
+	// a failed page is kept in `error` for the next head() instead.
+	prefetch() {
+		if (this.pending || this.done || this.error) return;
+		this.pending = this.readPage().then(
+			(fresh) => {
+				this.pending = null;
+				if (fresh.length === 0) {
+					this.done = true;
+					return;
+				}
+				this.last = fresh[fresh.length - 1];
+				this.rows = this.rows.slice(this.pos).concat(fresh);
+				this.pos = 0;
+			},
+			(err) => {
+				this.pending = null;
+				this.error = err;
+			}
+		);
+		return this.pending;
+	}
+
+	async readPage() {
+		const page = await this.fetchPage(this.last ? { after: this.last } : {}, this.pageSize);
+		if (page.length < this.pageSize) {
+			this.done = true;
+			return page;
+		}
+		const lastTime = rowTime(page[page.length - 1]);
+		let cut = page.length;
+		while (cut > 0 && rowTime(page[cut - 1]) === lastTime) cut--;
+		const ties = await this.fetchPage({ at: page[page.length - 1] }, null);
+		return page.slice(0, cut).concat(ties);
+	}
+
+	// Next row without consuming it; null once the camera is exhausted
+	async head() {
+		while (this.pos >= this.rows.length) {
+			if (this.error) throw this.error;
+			if (this.done) return null;
+			await (this.pending || this.prefetch());
+		}
+		// Half a page left: fetch the next one in the background
+		if (this.rows.length - this.pos <= this.pageSize / 2) this.prefetch();
+		return this.rows[this.pos];
+	}
+
+	take() {
+		return this.rows[this.pos++];
+	}
+}
+
+// scans: PagedScan per camera. Yields rows in global time order (ties by camNo), at most `limit`.
+async function* mergeFrames(scans, { limit = Infinity } = {}) {
+	const heap = new MinHeap((a, b) => a.time < b.time || (a.time === b.time && a.row.camNo < b.row.camNo));
+
+	const heads = await Promise.all(scans.map((scan) => scan.head()));
+	heads.forEach((row, i) => {
+		if (row) heap.push({ row, time: rowTime(row), scan: scans[i] });
+	});
+
+	let emitted = 0;
+	while (heap.size > 0 && emitted < limit) {
+		const top = heap.pop();
+		yield top.scan.take();
+		emitted++;
+		const next = await top.scan.head();
+		if (next) heap.push({ row: next, time: rowTime(next), scan: top.scan });
+	}
+}
+
+module.exports = { mergeFrames, PagedScan, MinHeap };
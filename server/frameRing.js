@@ -0,0 +1,130 @@
+// Hot in-memory ring of recent frames per camera
+//
+// Keeps the last `windowMs` of frames for each camera, capped at `maxBytes`
+// per camera and `maxTotalBytes` over all of them (past that the globally
+// oldest frames go first, whichever camera they belong to), so "replay the
+// last 30 seconds" and single-frame lookups never touch MariaDB or the disk -
+// including frames whose index rows are still waiting in the DB batch. Frames
+// are kept in arrival order; cameras send monotonically increasing capture
+// timestamps, which lookups rely on.
+
+class CameraRing {
+	constructor() {
+		this.frames = [];
+		this.head = 0; // index of the oldest live frame in `frames`
+		this.bytes = 0;
+	}
+
+	get size() {
+		return this.frames.length - this.head;
+	}
+
+	oldest() {
+		return this.size > 0 ? this.frames[this.head] : null;
+	}
+
+	newest() {
+		return this.size > 0 ? this.frames[this.frames.length - 1] : null;
+	}
+
+	shift() {
+		const entry = this.frames[this.head];
+		this.frames[this.head++] = undefined;
+		this.bytes -= entry.imageBuffer.length;
+
+		// Compact once the dead prefix dominates, keeping shift O(1) amortized
+		if (this.head > 1024 && this.head * 2 > this.frames.length) {
+			this.frames = this.frames.slice(this.head);
+			this.head = 0;
+		}
+		return entry;
+	}
+
+	// First index whose timestamp is > ms (or >= ms when inclusive)
+	lowerBound(ms, inclusive) {
+		let lo = this.head;
+		let hi = this.frames.length;
+		while (lo < hi) {
+			const mid = (lo + hi) >>> 1;
+			const ts = this.frames[mid].timestamp;
+			if (ts < ms || (!inclusive && ts === ms)) lo = mid + 1;
+			else hi = mid;
+		}
+		return lo;
+	}
+}
+
+class FrameRing {
+	constructor({ windowMs, maxBytes, maxTotalBytes = Infinity }) {
+		this.windowMs = windowMs;
+		this.maxBytes = maxBytes;
+		this.maxTotalBytes = maxTotalBytes;
+		this.bytes = 0; // over all cameras
+		this.cameras = new Map(); // camNo -> CameraRing
+		this.byFilename = new Map(); // stored filename (camNo-prefixed, so unique across cameras) -> entry
+	}
+
+	// entry: { camNo, filename, timestamp, format, imageBuffer }
+	// imageBuffer must stay valid after the call; shared-memory slots are copied by the caller.
+	add(entry) {
+		let ring = this.cameras.get(entry.camNo);
+		if (!ring) {
+			ring = new CameraRing();
+			this.cameras.set(entry.camNo, ring);
+		}
+
+		ring.frames.push(entry);
+		ring.bytes += entry.imageBuffer.length;
+		this.bytes += entry.imageBuffer.length;
+		this.byFilename.set(entry.filename, entry);
+
+		const horizon = entry.timestamp - this.windowMs;
+		while (ring.size > 1 && (ring.bytes > this.maxBytes || ring.oldest().timestamp < horizon)) {
+			this.evict(ring);
+		}
+
+		while (this.bytes > this.maxTotalBytes) {
+			// Oldest frame of any camera, keeping each camera's newest
+			let victim = null;
+			for (const r of this.cameras.values()) {
+				if (r.size > 1 && (!victim || r.oldest().timestamp < victim.oldest().timestamp)) victim = r;
+			}
+			if (!victim) break;
+			this.evict(victim);
+		}
+	}
+
+	evict(ring) {
+		const evicted = ring.shift();
+		this.bytes -= evicted.imageBuffer.length;
+		if (this.byFilename.get(evicted.filename) === evicted) this.byFilename.delete(evicted.filename);
+	}
+
+	get(filename) {
+		return this.byFilename.get(filename) || null;
+	}
+
+	// True when every frame of camNo at or after `ms` is still in memory
+	covers(camNo, ms) {
+		const ring = this.cameras.get(camNo);
+		const oldest = ring && ring.oldest();
+		return Boolean(oldest) && oldest.timestamp <= ms;
+	}
+
+	// Up to `limit` frames of camNo after `ms` (at or after when inclusive), oldest first.
+	// Returns null when the ring does not reach back to `ms`; the caller must use the index.
+	framesAfter(camNo, ms, inclusive, limit) {
+		if (!this.covers(camNo, ms)) return null;
+		const ring = this.cameras.get(camNo);
+		const start = ring.lowerBound(ms, inclusive);
+		return ring.frames.slice(start, Math.min(start + limit, ring.frames.length));
+	}
+
+	stats() {
+		let frames = 0;
+		for (const ring of this.cameras.values()) frames += ring.size;
+		return { cameras: this.cameras.size, frames, bytes: this.bytes };
+	}
+}
+
+module.exports = { FrameRing };
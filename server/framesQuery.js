@@ -0,0 +1,203 @@
+// GET /api/frames query building
+//
+// buildFramesQuery() turns request query options into SQL plus a normalized
+// cache key and a `matches(camNo, date)` predicate telling whether a newly
+// indexed frame would fall inside the result, so caches can be invalidated
+// exactly when the DB batcher inserts rows they cover.
+
+const FRAMES_LIMIT = 5000;
+const MAX_CAMERAS = 16;
+
+const SELECT_COLUMNS = 'camNo, t_year, t_mon, t_mday, t_hour, t_min, t_sec, t_mill, l_location';
+const ORDER_BY = 'ORDER BY t_year, t_mon, t_mday, t_hour, t_min, t_sec, t_mill';
+const ORDER_BY_DESC =
+	'ORDER BY t_year DESC, t_mon DESC, t_mday DESC, t_hour DESC, t_min DESC, t_sec DESC, t_mill DESC';
+const NEAREST_DIRS = ['before', 'after', 'nearest'];
+
+function fieldsFromMs(ms) {
+	const d = new Date(ms);
+	return {
+		year: d.getFullYear(),
+		mon: d.getMonth() + 1,
+		mday: d.getDate(),
+		hour: d.getHours(),
+		min: d.getMinutes(),
+		sec: d.getSeconds(),
+		mill: d.getMilliseconds(),
+	};
+}
+
+function fieldsOfRow(r) {
+	return {
+		year: r.t_year,
+		mon: r.t_mon,
+		mday: r.t_mday,
+		hour: r.t_hour,
+		min: r.t_min,
+		sec: r.t_sec,
+		mill: r.t_mill,
+	};
+}
+
+// (t_year, ..., t_mill) >= f  (or >, <=, <) as an OR-chain the composite index can use
+function tupleBound(op, f) {
+	const strict = op[0];
+	const sql = `
+        AND (
+            (t_year ${strict} ?) OR
+            (t_year = ? AND t_mon ${strict} ?) OR
+            (t_year = ? AND t_mon = ? AND t_mday ${strict} ?) OR
+            (t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour ${strict} ?) OR
+            (t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour = ? AND t_min ${strict} ?) OR
+            (t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour = ? AND t_min = ? AND t_sec ${strict} ?) OR
+            (t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour = ? AND t_min = ? AND t_sec = ? AND t_mill ${op} ?)
+        )`;
+	// prettier-ignore
+	const params = [
+		f.year,
+		f.year, f.mon,
+		f.year, f.mon, f.mday,
+		f.year, f.mon, f.mday, f.hour,
+		f.year, f.mon, f.mday, f.hour, f.min,
+		f.year, f.mon, f.mday, f.hour, f.min, f.sec,
+		f.year, f.mon, f.mday, f.hour, f.min, f.sec, f.mill,
+	];
+	return { sql, params };
+}
+
+// camNo=CAM0,CAM1 and/or repeated camNo= -> ['CAM0', 'CAM1'] (deduplicated, order kept)
+function parseCameraList(q) {
+	const cameras = [];
+	for (const value of [].concat(q.camNo || [])) {
+		for (const camNo of String(value).split(',')) {
+			const trimmed = camNo.trim();
+			if (trimmed && !cameras.includes(trimmed)) cameras.push(trimmed);
+		}
+	}
+	return cameras;
+}
+
+// Returns { camNo, key, sql, params, matches } or { error }
+// limit: row cap (FRAMES_LIMIT by default); null streams the whole range
+// Keyset paging (see frameMerge.js), both tb_index rows:
+//   after: only rows strictly after its timestamp
+//   at:    every row at exactly its timestamp, ordered by l_location (no limit)
+// Query options:
+//  - camNo (required)
+//  - timestamp (epoch ms)  OR  start (epoch ms) & end (epoch ms)
+//  - OR year, month, day, hour, minute, second
+function buildFramesQuery(q, { limit = FRAMES_LIMIT, after = null, at = null } = {}) {
+	if (!q.camNo) return { error: 'camNo is required' };
+	const camNo = String(q.camNo);
+
+	const ts = q.timestamp ? Number(q.timestamp) : null;
+	const start = q.start ? Number(q.start) : null;
+	const end = q.end ? Number(q.end) : null;
+
+	let sql = `
+		SELECT ${SELECT_COLUMNS}
+		FROM tb_index
+		WHERE camNo = ?
+	`;
+	const params = [camNo];
+	let key;
+	let matchesTime;
+
+	if (ts) {
+		// Whole second containing ts
+		const f = fieldsFromMs(ts);
+		sql += ` AND t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour = ? AND t_min = ? AND t_sec = ? `;
+		params.push(f.year, f.mon, f.mday, f.hour, f.min, f.sec);
+		const secStart = ts - f.mill;
+		key = `ts:${secStart}`;
+		matchesTime = (ms) => ms >= secStart && ms < secStart + 1000;
+	} else if (start && end) {
+		const lower = tupleBound('>=', fieldsFromMs(start));
+		const upper = tupleBound('<=', fieldsFromMs(end));
+		sql += lower.sql + upper.sql;
+		params.push(...lower.params, ...upper.params);
+		key = `range:${start}-${end}`;
+		matchesTime = (ms) => ms >= start && ms <= end;
+	} else {
+		const parts = [
+			['year', 't_year', (d) => d.getFullYear()],
+			['month', 't_mon', (d) => d.getMonth() + 1],
+			['day', 't_mday', (d) => d.getDate()],
+			['hour', 't_hour', (d) => d.getHours()],
+			['minute', 't_min', (d) => d.getMinutes()],
+			['second', 't_sec', (d) => d.getSeconds()],
+		];
+		const filters = [];
+		for (const [name, column, get] of parts) {
+			const v = q[name] ? Number(q[name]) : null;
+			if (!v) continue;
+			sql += ` AND ${column} = ? `;
+			params.push(v);
+			filters.push([get, v]);
+		}
+		key = `fields:${parts.map(([name]) => (q[name] ? Number(q[name]) : '')).join(',')}`;
+		matchesTime = (ms) => {
+			const d = new Date(ms);
+			return filters.every(([get, v]) => get(d) === v);
+		};
+	}
+
+	if (after) {
+		const bound = tupleBound('>', fieldsOfRow(after));
+		sql += bound.sql;
+		params.push(...bound.params);
+		key += `|after:${bound.params.slice(-7).join(',')}`;
+	}
+
+	if (at) {
+		const f = fieldsOfRow(at);
+		sql += ` AND t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour = ? AND t_min = ? AND t_sec = ? AND t_mill = ?
+			ORDER BY l_location;`;
+		params.push(f.year, f.mon, f.mday, f.hour, f.min, f.sec, f.mill);
+		key += `|at:${params.slice(-7).join(',')}`;
+	} else {
+		sql += limit ? ` ${ORDER_BY} LIMIT ${Number(limit)};` : ` ${ORDER_BY};`;
+	}
+
+	return {
+		camNo,
+		key: `${camNo}|${key}`,
+		sql,
+		params,
+		matches: (rowCamNo, date) => rowCamNo === camNo && matchesTime(date.getTime()),
+	};
+}
+
+// GET /api/frames/nearest: one index seek per direction (LIMIT 1 along the composite index).
+// Returns { camNo, ts, dir, seeks: [{ sql, params }] } or { error }; 'nearest' runs both seeks.
+function buildNearestQuery(q) {
+	if (!q.camNo) return { error: 'camNo is required' };
+	const ts = Number(q.ts);
+	if (!q.ts || !Number.isFinite(ts)) return { error: 'ts (epoch ms) is required' };
+	const dir = q.dir ? String(q.dir) : 'nearest';
+	if (!NEAREST_DIRS.includes(dir)) return { error: 'dir must be before, after or nearest' };
+
+	const camNo = String(q.camNo);
+	const f = fieldsFromMs(ts);
+	const seek = (op, order) => {
+		const bound = tupleBound(op, f);
+		return {
+			sql: `SELECT ${SELECT_COLUMNS} FROM tb_index WHERE camNo = ? ${bound.sql} ${order} LIMIT 1;`,
+			params: [camNo, ...bound.params],
+		};
+	};
+
+	const seeks = [];
+	if (dir !== 'after') seeks.push(seek('<=', ORDER_BY_DESC));
+	if (dir !== 'before') seeks.push(seek('>=', ORDER_BY));
+	return { camNo, ts, dir, seeks };
+}
+
+module.exports = {
+	buildFramesQuery,
+	buildNearestQuery,
+	parseCameraList,
+	fieldsFromMs,
+	FRAMES_LIMIT,
+	MAX_CAMERAS,
+};
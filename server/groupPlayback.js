@@ -0,0 +1,174 @@
+// Synchronized multi-camera playback
+//
+// One master clock drives every camera of a group: media time advances at
+// `speed` from the first frame (and stands still while paused), and each frame
+// is sent when the clock reaches its timestamp. The cameras' index scans are
+// merged into one schedule (frameMerge.js) and frame files are read ahead in
+// schedule order, so all cameras are prefetched together. Whenever the clock
+// catches up with the schedule, every frame now due is taken and each camera
+// sends only its newest one; older ones are dropped rather than sent late.
+// Every camera then shows its latest frame at or before the same media time,
+// so cameras stay within one frame interval of each other even when reads
+// or the viewer can't keep up with the speed. Gaps longer than `maxGapMs`
+// (no camera recording) are skipped for the whole group at once.
+
+const { performance } = require('perf_hooks');
+const { mergeFrames } = require('./frameMerge');
+
+class MasterClock {
+	constructor(startMs, speed) {
+		this.speed = speed;
+		this.startMs = startMs;
+		this.wallStart = performance.now();
+		this.pausedAt = null;
+	}
+
+	mediaNow() {
+		const wall = this.pausedAt !== null ? this.pausedAt : performance.now();
+		return this.startMs + (wall - this.wallStart) * this.speed;
+	}
+
+	// Wall-clock delay until the clock reaches mediaMs
+	delayUntil(mediaMs) {
+		return (mediaMs - this.mediaNow()) / this.speed;
+	}
+
+	pause() {
+		if (this.pausedAt === null) this.pausedAt = performance.now();
+	}
+
+	resume() {
+		if (this.pausedAt === null) return;
+		this.wallStart += performance.now() - this.pausedAt;
+		this.pausedAt = null;
+	}
+
+	// Move media time forward by ms (all cameras together)
+	skip(ms) {
+		this.wallStart -= ms / this.speed;
+	}
+
+	// New speed from the current media time on
+	setSpeed(speed) {
+		const now = performance.now();
+		this.startMs = this.mediaNow();
+		this.wallStart = this.pausedAt !== null ? this.pausedAt : now;
+		this.speed = speed;
+	}
+}
+
+const sleep = (ms) => new Promise((r) => setTimeout(r, ms));
+
+// session: { cameras, speed, active, paused }; scans: PagedScan per camera (frameMerge.js)
+// readFrame(row) -> Promise<frame>; send(row, frame, err) delivers one frame (or its read
+// error) and returns false when flow control held it back. onPause() runs once when the clock stops;
+// allowReadAhead(queued) may hold back reads beyond the frames already queued (the load shedder's
+// read-ahead limit; an empty queue is always refilled). session.speed may change at any time.
+// Resolves { sent, dropped, empty }.
+async function runGroupPlayback(
+	session,
+	scans,
+	{ readFrame, send, onPause, allowReadAhead = () => true, readAhead = 8, maxGapMs = 2000 }
+) {
+	const schedule = mergeFrames(scans);
+	const queue = []; // { row, time, image: Promise<{ frame } | { err }> } in schedule order
+	let exhausted = false;
+	let failure = null;
+	let filling = null;
+
+	const readMore = async () => {
+		while (!exhausted && queue.length < readAhead && (queue.length === 0 || allowReadAhead(queue.length))) {
+			const { value: row, done } = await schedule.next();
+			if (done) {
+				exhausted = true;
+				break;
+			}
+			queue.push({
+				row,
+				time: Date.UTC(row.t_year, row.t_mon - 1, row.t_mday, row.t_hour, row.t_min, row.t_sec, row.t_mill),
+				image: readFrame(row).then(
+					(frame) => ({ frame }),
+					(err) => ({ err })
+				),
+			});
+		}
+	};
+	// One refill at a time; a scan error ends the schedule and is rethrown by the loop
+	const fill = () => {
+		if (!filling) {
+			filling = readMore()
+				.catch((err) => {
+					failure = err;
+					exhausted = true;
+				})
+				.finally(() => (filling = null));
+		}
+		return filling;
+	};
+
+	await fill();
+	if (failure) throw failure;
+	if (queue.length === 0) return { sent: 0, dropped: 0, empty: true };
+
+	const clock = new MasterClock(queue[0].time, session.speed);
+	let sent = 0;
+	let dropped = 0;
+
+	while (session.active) {
+		if (queue.length === 0) {
+			await fill();
+			if (failure) throw failure;
+			if (queue.length === 0) break;
+		}
+		if (session.speed !== clock.speed) clock.setSpeed(session.speed);
+		if (session.paused) {
+			if (clock.pausedAt === null) {
+				clock.pause();
+				if (onPause) await onPause();
+			}
+			await sleep(100);
+			continue;
+		}
+		clock.resume();
+
+		// Nothing recorded for a while on any camera: jump the shared clock
+		const ahead = queue[0].time - clock.mediaNow();
+		if (ahead > maxGapMs) clock.skip(ahead);
+
+		// Short sleeps, so pause and stop take effect between frames
+		const wait = clock.delayUntil(queue[0].time);
+		if (wait > 0) {
+			await sleep(Math.min(wait, 100));
+			continue;
+		}
+
+		// Everything due by now: each camera shows only its newest frame
+		const now = clock.mediaNow();
+		const due = new Map(); // camNo -> queue item
+		for (;;) {
+			if (queue.length === 0) {
+				await fill();
+				if (failure) throw failure;
+				if (queue.length === 0) break;
+			}
+			if (queue[0].time > now) break;
+			const item = queue.shift();
+			if (due.has(item.row.camNo)) dropped++;
+			due.set(item.row.camNo, item);
+		}
+		fill(); // keep prefetching while these frames go out
+
+		// Wait for every image first, so the cameras update together
+		const items = [...due.values()].sort((a, b) => a.time - b.time);
+		const images = await Promise.all(items.map((item) => item.image));
+		if (!session.active) break;
+		items.forEach((item, i) => {
+			if (images[i].err) return send(item.row, null, images[i].err);
+			if (send(item.row, images[i].frame) !== false) sent++;
+		});
+	}
+
+	return { sent, dropped, empty: false };
+}
+
+module.exports = { runGroupPlayback, MasterClock };
@@ -0,0 +1,219 @@
+// Per-camera activity heatmaps: hourly accumulator grids (tb_heatmap)
+//
+// Every scored frame from the motion index (motionIndex.js onDiff) adds its
+// changed-cell mask to the grid of its camera and hour, so a cell's count is
+// the number of frames in which that part of the picture moved. New counts
+// collect in memory as per-hour deltas and are added to the stored rows
+// every `flushMs`; a row is one hour of one camera:
+//   camNo, hour (wall-clock ms, like rollups.js), frames, grid
+//   grid = cols x rows u32 little-endian counts, top row first (3 KB at 32x24)
+// A time range is answered by summing its hourly rows (plus unflushed
+// deltas), so a week is 168 small rows however much footage it holds.
+
+const { log } = require('./log');
+const { wallClockMs, GRAINS } = require('./rollups');
+const { makeBmpHeader } = require('./frameFormat');
+
+const HEATMAP_MAX_HOURS = 24 * 366;
+
+const CREATE_SQL = `
+	CREATE TABLE IF NOT EXISTS tb_heatmap (
+		camNo VARCHAR(32) NOT NULL,
+		hour BIGINT NOT NULL,
+		frames INT UNSIGNED NOT NULL,
+		grid BLOB NOT NULL,
+		PRIMARY KEY (camNo, hour)
+	)
+`;
+
+function hourOf(ts) {
+	return Math.floor(ts / GRAINS.hour) * GRAINS.hour;
+}
+
+function gridFromBlob(blob, cells) {
+	const grid = new Uint32Array(cells);
+	for (let i = 0; i < cells && i * 4 + 4 <= blob.length; i++) grid[i] = blob.readUInt32LE(i * 4);
+	return grid;
+}
+
+function gridToBlob(grid) {
+	const blob = Buffer.alloc(grid.length * 4);
+	grid.forEach((v, i) => blob.writeUInt32LE(v, i * 4));
+	return blob;
+}
+
+// Color ramp for rendered heatmaps: black -> blue -> red -> yellow -> white
+const RAMP = [
+	[0, 0, 0],
+	[0, 0, 160],
+	[200, 0, 0],
+	[255, 200, 0],
+	[255, 255, 255],
+];
+
+// Summed grid -> top-down 24-bit BMP, `scale` pixels per cell, colors relative to the busiest cell
+function renderHeatmap(grid, cols, rows, scale) {
+	const max = Math.max(1, ...grid);
+	const width = cols * scale;
+	const height = rows * scale;
+	const stride = (width * 3 + 3) & ~3;
+	const pixels = Buffer.alloc(stride * height);
+	for (let cy = 0; cy < rows; cy++) {
+		for (let cx = 0; cx < cols; cx++) {
+			const t = (grid[cy * cols + cx] / max) * (RAMP.length - 1);
+			const i = Math.min(RAMP.length - 2, Math.floor(t));
+			const f = t - i;
+			const [r, g, b] = RAMP[i].map((c, k) => Math.round(c + (RAMP[i + 1][k] - c) * f));
+			for (let y = cy * scale; y < (cy + 1) * scale; y++) {
+				for (let x = cx * scale; x < (cx + 1) * scale; x++) {
+					const p = y * stride + x * 3;
+					pixels[p] = b;
+					pixels[p + 1] = g;
+					pixels[p + 2] = r;
+				}
+			}
+		}
+	}
+	return Buffer.concat([makeBmpHeader(width, height, pixels.length), pixels]);
+}
+
+class HeatmapStore {
+	constructor({ writer, cols, rows, flushMs = 10000 }) {
+		this.writer = writer;
+		this.cols = cols;
+		this.rows = rows;
+		this.cells = cols * rows;
+		this.flushMs = flushMs;
+		this.deltas = new Map(); // `${camNo}|${hour}` -> { camNo, hour, frames, grid }
+		this.enabled = false;
+		this.flushing = null;
+		this.timer = null;
+	}
+
+	async init() {
+		await this.writer.withConnection((conn) => conn.query(CREATE_SQL));
+		this.enabled = true;
+		this.timer = setInterval(() => this.flush(), this.flushMs);
+		this.timer.unref();
+	}
+
+	// One scored frame: changed is the motion mask (1 per moved cell)
+	add(camNo, timestamp, changed) {
+		if (!this.enabled || changed.length !== this.cells) return;
+		const hour = hourOf(wallClockMs(timestamp));
+		const key = `${camNo}|${hour}`;
+		let delta = this.deltas.get(key);
+		if (!delta) {
+			delta = { camNo, hour, frames: 0, grid: new Uint32Array(this.cells) };
+			this.deltas.set(key, delta);
+		}
+		delta.frames++;
+		for (let i = 0; i < changed.length; i++) delta.grid[i] += changed[i];
+	}
+
+	// Add the collected deltas to their stored rows (read, sum, write back in one transaction)
+	flush() {
+		if (!this.flushing && this.deltas.size > 0) {
+			this.flushing = this.writeDeltas().finally(() => (this.flushing = null));
+		}
+		return this.flushing || Promise.resolve();
+	}
+
+	async writeDeltas() {
+		const batch = [...this.deltas.values()];
+		this.deltas = new Map();
+		try {
+			await this.writer.withConnection(async (conn) => {
+				await conn.beginTransaction();
+				try {
+					// One locking read and one multi-row upsert per flush, however many hours changed
+					const keys = batch.map(() => '(?, ?)').join(', ');
+					const rows = await conn.query(
+						`SELECT camNo, hour, frames, grid FROM tb_heatmap WHERE (camNo, hour) IN (${keys}) FOR UPDATE`,
+						batch.flatMap((d) => [d.camNo, d.hour])
+					);
+					const stored = new Map(rows.map((r) => [`${r.camNo}|${Number(r.hour)}`, r]));
+
+					const values = batch.flatMap((d) => {
+						const row = stored.get(`${d.camNo}|${d.hour}`);
+						const grid = row ? gridFromBlob(row.grid, this.cells) : new Uint32Array(this.cells);
+						for (let i = 0; i < grid.length; i++) grid[i] += d.grid[i];
+						return [d.camNo, d.hour, (row ? row.frames : 0) + d.frames, gridToBlob(grid)];
+					});
+					await conn.query(
+						`INSERT INTO tb_heatmap (camNo, hour, frames, grid) VALUES ${batch.map(() => '(?, ?, ?, ?)').join(', ')}
+						ON DUPLICATE KEY UPDATE frames = VALUES(frames), grid = VALUES(grid)`,
+						values
+					);
+					await conn.commit();
+				} catch (err) {
+					await conn.rollback().catch(() => {});
+					throw err;
+				}
+			});
+		} catch (err) {
+			log(`[HEATMAP] Flush error: ${err.message}`, 'ERROR');
+			// Keep the counts for the next flush
+			for (const d of batch) {
+				const key = `${d.camNo}|${d.hour}`;
+				const newer = this.deltas.get(key);
+				if (newer) {
+					newer.frames += d.frames;
+					for (let i = 0; i < d.grid.length; i++) newer.grid[i] += d.grid[i];
+				} else {
+					this.deltas.set(key, d);
+				}
+			}
+		}
+	}
+
+	async stop() {
+		clearInterval(this.timer);
+		await this.flushing;
+		await this.flush();
+	}
+
+	// Returns { camNo, start, end, sql, params } or { error }. start & end epoch ms; whole hours are summed.
+	buildQuery(q) {
+		if (!q.camNo) return { error: 'camNo is required' };
+		const start = Number(q.start);
+		const end = Number(q.end);
+		if (!q.start || !q.end || !(end > start)) return { error: 'start & end (epoch ms) are required' };
+
+		const first = hourOf(wallClockMs(new Date(start)));
+		const last = wallClockMs(new Date(end));
+		if ((last - first) / GRAINS.hour > HEATMAP_MAX_HOURS) return { error: `At most ${HEATMAP_MAX_HOURS} hours` };
+
+		const camNo = String(q.camNo);
+		return {
+			camNo,
+			start,
+			end,
+			first,
+			last,
+			sql: 'SELECT hour, frames, grid FROM tb_heatmap WHERE camNo = ? AND hour >= ? AND hour <= ?',
+			params: [camNo, first, last],
+		};
+	}
+
+	// Stored rows of a buildQuery() plus unflushed deltas -> { hours, frames, grid }
+	sum(query, rows) {
+		const grid = new Uint32Array(this.cells);
+		const hours = new Set();
+		let frames = 0;
+		const addGrid = (hour, n, cells) => {
+			hours.add(hour);
+			frames += n;
+			for (let i = 0; i < grid.length; i++) grid[i] += cells[i];
+		};
+
+		for (const r of rows) addGrid(Number(r.hour), r.frames, gridFromBlob(r.grid, this.cells));
+		// Deltas taken by a flush in progress are left out until they are stored
+		for (const d of this.deltas.values()) {
+			if (d.camNo === query.camNo && d.hour >= query.first && d.hour <= query.last) addGrid(d.hour, d.frames, d.grid);
+		}
+		return { hours: hours.size, frames, grid };
+	}
+}
+
+module.exports = { HeatmapStore, renderHeatmap };
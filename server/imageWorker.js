@@ -0,0 +1,99 @@
+// worker_threads entry for image work off the event loop (see workerPool.js)
+//
+// Each message is { op, ... }; the reply is { result } or { error }.
+//   frameJpeg: { filePath, scale, quality } -> JPEG (Uint8Array) of the stored frame, 1/scale size
+//   tile:      { filePath, jpeg, width } -> top-down BMP about `width` pixels wide, from the
+//              proxy JPEG when one is given (much less to read), else from the frame file
+//   jpeg:      { bmp, quality } -> JPEG of a BMP
+//   lumaGrid:  { filePath | bmp, cols, rows } -> mean luma per grid cell (frameFormat.js lumaGrid) of
+//              a frame file or of frame bytes (BMP or raw)
+
+const { parentPort } = require('worker_threads');
+const fs = require('fs').promises;
+// Loaded on first use: analysis ops don't need it
+let Jimp = null;
+const jimp = () => Jimp || (Jimp = require('jimp'));
+const { frameFileToBmp, downscaleBmp, makeBmpHeader, lumaGrid: bmpLumaGrid } = require('./frameFormat');
+
+// Uint8Array from postMessage viewed as a Buffer, without copying
+const asBuffer = (bytes) => Buffer.from(bytes.buffer, bytes.byteOffset, bytes.length);
+
+// Top-down 24-bit BMP (downscaleBmp output) -> Jimp image
+function bmpToJimp(bmp) {
+	const width = bmp.readInt32LE(18);
+	const height = Math.abs(bmp.readInt32LE(22));
+	const offset = bmp.readUInt32LE(10);
+	const stride = (width * 3 + 3) & ~3;
+	const rgba = Buffer.alloc(width * height * 4);
+	for (let y = 0; y < height; y++) {
+		let src = offset + y * stride;
+		let dst = y * width * 4;
+		for (let x = 0; x < width; x++, src += 3, dst += 4) {
+			rgba[dst] = bmp[src + 2];
+			rgba[dst + 1] = bmp[src + 1];
+			rgba[dst + 2] = bmp[src];
+			rgba[dst + 3] = 255;
+		}
+	}
+	return new (jimp())({ data: rgba, width, height });
+}
+
+// Jimp image -> top-down 24-bit BMP
+function jimpToBmp(image) {
+	const { data, width, height } = image.bitmap;
+	const stride = (width * 3 + 3) & ~3;
+	const pixels = Buffer.alloc(stride * height);
+	for (let y = 0; y < height; y++) {
+		let src = y * width * 4;
+		let dst = y * stride;
+		for (let x = 0; x < width; x++, src += 4, dst += 3) {
+			pixels[dst] = data[src + 2];
+			pixels[dst + 1] = data[src + 1];
+			pixels[dst + 2] = data[src];
+		}
+	}
+	return Buffer.concat([makeBmpHeader(width, height, pixels.length), pixels]);
+}
+
+async function frameJpeg({ filePath, scale, quality }) {
+	const bmp = frameFileToBmp(await fs.readFile(filePath));
+	// downscaleBmp also normalizes to top-down rows, so scale 1 goes through it too
+	const small = downscaleBmp(bmp, scale);
+	if (!small) throw new Error('Not a 24-bit BMP frame');
+	return bmpToJimp(small).quality(quality).getBufferAsync(jimp().MIME_JPEG);
+}
+
+async function tile({ filePath, jpeg, width }) {
+	const bmp = jpeg ? jimpToBmp(await jimp().read(asBuffer(jpeg))) : frameFileToBmp(await fs.readFile(filePath));
+	const factor = Math.max(1, Math.floor(bmp.readInt32LE(18) / width));
+	const small = downscaleBmp(bmp, factor);
+	if (!small) throw new Error('Not a 24-bit BMP frame');
+	return small;
+}
+
+async function jpeg({ bmp, quality }) {
+	return bmpToJimp(asBuffer(bmp)).quality(quality).getBufferAsync(jimp().MIME_JPEG);
+}
+
+async function lumaGrid({ filePath, bmp, cols, rows }) {
+	const frame = bmp ? asBuffer(bmp) : await fs.readFile(filePath);
+	const grid = bmpLumaGrid(frameFileToBmp(frame), cols, rows);
+	if (!grid) throw new Error('Not a 24-bit BMP frame');
+	return grid;
+}
+
+const ops = { frameJpeg, tile, jpeg, lumaGrid };
+
+parentPort.on('message', async (task) => {
+	try {
+		const op = ops[task.op];
+		if (!op) throw new Error(`Unknown op ${task.op}`);
+		const result = await op(task);
+		// Hand the bytes over instead of copying them back (never a shared pool slab)
+		const bytes = new Uint8Array(result.buffer, result.byteOffset, result.length);
+		const exclusive = result.byteOffset === 0 && result.buffer.byteLength === result.length;
+		parentPort.postMessage({ result: bytes }, exclusive ? [bytes.buffer] : []);
+	} catch (err) {
+		parentPort.postMessage({ error: err.message });
+	}
+});
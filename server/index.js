@@ -1,12 +1,55 @@
 require('dotenv').config();
 const net = require('net');
 const { WebSocketServer } = require('ws');
-const mariadb = require('mariadb');
 const path = require('path');
 const express = require('express');
 const http = require('http');
 const fs = require('fs').promises;
 const EventEmitter = require('events');
+const os = require('os');
+const { performance, monitorEventLoopDelay } = require('perf_hooks');
+const { log } = require('./log');
+const { startShmTransport } = require('./shmTransport');
+const { IngestParser, makeBanner } = require('./ingestProtocol');
+const { FrameRing } = require('./frameRing');
+const { Registry, CameraLabels } = require('./metrics');
+const { FrameTracer } = require('./trace');
+const { LoadShedder } = require('./loadShedder');
+const {
+	buildFramesQuery,
+	buildNearestQuery,
+	parseCameraList,
+	FRAMES_LIMIT,
+	MAX_CAMERAS,
+} = require('./framesQuery');
+const { mergeFrames, PagedScan } = require('./frameMerge');
+const { runGroupPlayback } = require('./groupPlayback');
+const { PlaybackFlow } = require('./playbackFlow');
+const { QueryCache } = require('./queryCache');
+const { encodeColumnar } = require('./columnar');
+const { ensureRollupTable, invalidateRollups, rollupUpsert, buildTimelineQuery } = require('./rollups');
+const { createDbPools, QueryCursor } = require('./dbPools');
+const { WorkerPool } = require('./workerPool');
+const { ProxyStore } = require('./proxyStore');
+const { buildContactSheetQuery, composeContactSheet } = require('./contactSheet');
+const { exportClip, EXPORT_FORMATS } = require('./clipExport');
+const {
+	MotionIndex,
+	buildMotionSeekQuery,
+	buildMotionIntervalsQuery,
+	fromWallClockMs,
+	MOTION_GRID_COLS,
+	MOTION_GRID_ROWS,
+} = require('./motionIndex');
+const { HeatmapStore, renderHeatmap } = require('./heatmaps');
+const { SimilarityIndex, dHash } = require('./similarityIndex');
+const {
+	rawFileName,
+	isRawFile,
+	makeRawHeader,
+	bmpParts,
+	frameFileToBmp,
+} = require('./frameFormat');
 
 // --- CONFIG ---
 const SOCKET_PORT = 9000;
@@ -21,20 +64,166 @@ const PLAYBACK_BATCH_SIZE = 200;
 const PLAYBACK_QUEUE_HIGH = 10;
 const PLAYBACK_QUEUE_LOW = 3;
 const PLAYBACK_DELAY_MS = 300;
-
-// Logging utility
-function log(message, level = 'INFO') {
-	const timestamp = new Date().toTimeString().substring(0, 12);
-	console.log(`[${timestamp}] [${level}] ${message}`);
-}
+const PLAYBACK_MAX_CURSORS = 2; // sessions streaming from a held reader connection; others use batches
+const PLAYBACK_CURSOR_WINDOW = 5000; // rows per cursor before it is re-planned from the last row
+const PLAYBACK_GROUP_READ_AHEAD = 16; // frame files read ahead across a synchronized group
+const PLAYBACK_SEND_WINDOW_BYTES = 4 * 1024 * 1024; // WebSocket backlog per session before frames are held back
+
+// Shared-memory transport (co-located camera service)
+const SHM_SOCKET_PATH = '/tmp/surveillance-shm.sock';
+const SHM_SLOT_COUNT = 8;
+const SHM_SLOT_SIZE = 1024 * 1024;
+
+// Live latency tracing: fraction of frames whose viewers echo display time
+const TRACE_SAMPLE_RATE = Number(process.env.TRACE_SAMPLE_RATE || 0.05);
+const METRICS_CAMERAS_MAX = 64; // cameras with their own metric labels; the rest share `other`
+
+// GET /api/frames result cache (invalidated by the DB batcher)
+const FRAMES_CACHE_TTL_MS = 30000;
+const FRAMES_CACHE_MAX_ENTRIES = 100;
+const FRAMES_MERGE_PAGE_SIZE = 1000; // rows per camera page in multi-camera queries
+const SHEET_CACHE_TTL_MS = 10 * 60 * 1000; // rendered contact sheets (invalidated by new rows in range)
+const SHEET_CACHE_MAX_ENTRIES = 20;
+
+// Recent-frame ring (instant replay without DB or disk)
+const RECENT_WINDOW_MS = 5 * 60 * 1000;
+const RECENT_MAX_BYTES_PER_CAMERA = 192 * 1024 * 1024;
+const RECENT_MAX_BYTES = 1024 * 1024 * 1024; // all cameras together
+
+// Low-resolution proxies (scrubbing, thumbnails, fast playback; see proxyStore.js)
+const PROXY_FOLDER = path.resolve('./proxyData');
+const PROXY_SCALE = 4;
+const PROXY_QUALITY = 70;
+const PROXY_MIN_SPEED = 8; // playback at this speed or faster is served from proxies
+const IMAGE_WORKERS = Math.max(1, Math.min(4, os.cpus().length - 1));
+
+// GET /api/export (streamed MJPEG clips; see clipExport.js)
+const EXPORT_PAGE_SIZE = 500;
+const EXPORT_READ_AHEAD = 2 * IMAGE_WORKERS; // frames being read / encoded ahead of the writer
+const EXPORT_DEFAULT_FPS = 10;
+const EXPORT_QUALITY = 85;
 
 log('Node.js surveillance server starting...');
 
+// --- Metrics (GET /metrics) ---
+const metrics = new Registry();
+const LATENCY_BUCKETS = [0.05, 0.1, 0.25, 0.5, 1, 1.5, 2, 3, 5, 10, 30];
+
+const mIngestFrames = metrics.counter('surveillance_ingest_frames_total', 'Frames received from cameras', [
+	'camera',
+	'transport',
+]);
+const mIngestBytes = metrics.counter('surveillance_ingest_bytes_total', 'Frame payload bytes received', [
+	'camera',
+	'transport',
+]);
+const mStorageDropped = metrics.counter(
+	'surveillance_storage_dropped_total',
+	'Frames dropped because the storage queue was full',
+	['camera']
+);
+const mDurable = metrics.histogram(
+	'surveillance_ingest_to_durable_seconds',
+	'Time from ingest until a frame is on disk and indexed',
+	['camera'],
+	LATENCY_BUCKETS
+);
+const mDbBatch = metrics.histogram('surveillance_db_batch_seconds', 'tb_index batch insert latency').labels();
+const mDbRows = metrics.counter('surveillance_db_rows_inserted_total', 'Rows inserted into tb_index').labels();
+const mDbErrors = metrics.counter('surveillance_db_batch_errors_total', 'Failed tb_index batch inserts').labels();
+const mPlaybackRead = metrics.histogram(
+	'surveillance_playback_read_seconds',
+	'Playback frame read latency (memory or disk)',
+	['camera']
+);
+const mPlaybackTtff = metrics.histogram(
+	'surveillance_playback_ttff_seconds',
+	'Time from playback-start to the first frame sent',
+	['camera'],
+	LATENCY_BUCKETS
+);
+
+const playbackFlowDecisions = metrics.counter(
+	'surveillance_playback_flow_total',
+	'Playback flow-control decisions (frames sent or held back, level changes)',
+	['action']
+);
+const mPlaybackFlow = {
+	sent: playbackFlowDecisions.labels('sent'),
+	decimated: playbackFlowDecisions.labels('decimated'),
+	windowFull: playbackFlowDecisions.labels('window_full'),
+	levelDown: playbackFlowDecisions.labels('level_down'),
+	levelUp: playbackFlowDecisions.labels('level_up'),
+};
+
+const cameraLabels = new CameraLabels(METRICS_CAMERAS_MAX);
+const tracer = new FrameTracer({ registry: metrics, cameraLabels, sampleRate: TRACE_SAMPLE_RATE });
+
+// Graduated shedding when the event loop stalls (see loadShedder.js)
+const shedder = new LoadShedder({ registry: metrics });
+shedder.start();
+
+const eventLoopDelay = monitorEventLoopDelay({ resolution: 20 });
+eventLoopDelay.enable();
+
+const framesCacheResults = metrics.counter('surveillance_frames_cache_total', 'GET /api/frames cache lookups', [
+	'result',
+]);
+const mFramesCache = {
+	hit: framesCacheResults.labels('hit'),
+	miss: framesCacheResults.labels('miss'),
+	coalesced: framesCacheResults.labels('coalesced'),
+};
+const mFramesCacheInvalidated = metrics
+	.counter('surveillance_frames_cache_invalidated_total', 'Cached /api/frames results dropped by new rows')
+	.labels();
+
+// camera label -> children resolved once, so the frame path only bumps numbers
+const cameraMetricsCache = new Map();
+
+function cameraMetrics(camNo) {
+	const camera = cameraLabels.of(camNo);
+	let m = cameraMetricsCache.get(camera);
+	if (!m) {
+		const ingest = {};
+		for (const transport of ['tcp', 'shm', 'post']) {
+			ingest[transport] = {
+				frames: mIngestFrames.labels(camera, transport),
+				bytes: mIngestBytes.labels(camera, transport),
+			};
+		}
+		m = {
+			ingest,
+			dropped: mStorageDropped.labels(camera),
+			durable: mDurable.labels(camera),
+			playbackRead: mPlaybackRead.labels(camera),
+			playbackTtff: mPlaybackTtff.labels(camera),
+		};
+		cameraMetricsCache.set(camera, m);
+	}
+	return m;
+}
+
 // Create storage folder
 fs.mkdir(BMP_FOLDER, { recursive: true })
 	.then(() => log(`Storage folder: ${BMP_FOLDER}`))
 	.catch((err) => log(`Storage folder error: ${err.message}`, 'ERROR'));
 
+// Image work (proxy encoding) runs on worker threads
+const imagePool = new WorkerPool(path.join(__dirname, 'imageWorker.js'), IMAGE_WORKERS);
+const proxies = new ProxyStore({
+	dir: PROXY_FOLDER,
+	pool: imagePool,
+	shedder,
+	registry: metrics,
+	scale: PROXY_SCALE,
+	quality: PROXY_QUALITY,
+});
+proxies
+	.init()
+	.then(() => log(`Proxy folder: ${PROXY_FOLDER} (1/${PROXY_SCALE} scale, ${IMAGE_WORKERS} workers)`))
+	.catch((err) => log(`Proxy folder error: ${err.message}`, 'ERROR'));
+
 // --- Express + WebSocket Setup ---
 const app = express();
 app.use(express.json({ limit: '20mb' })); // for parsing application/json
@@ -52,32 +241,46 @@ app.get('/playback', (req, res) => {
 	res.sendFile(path.join(__dirname, '../frontend/playback.html'));
 });
 
+// Route: Prometheus metrics
+app.get('/metrics', (req, res) => {
+	res.setHeader('Content-Type', Registry.CONTENT_TYPE);
+	res.end(metrics.render());
+});
+
 const server = http.createServer(app);
 const wss = new WebSocketServer({ server });
 
-// --- MariaDB Connection Pool ---
+// --- MariaDB Connection Pools ---
 const DB_HOST = 'localhost';
 const DB_PORT = 3306;
 const DB_USER = 'demo';
 const DB_PASSWORD = 'abdul';
 const DB_NAME = 'imgindex';
+const DB_WRITER_CONNECTIONS = 2; // pinned to the index batcher
+const DB_ANALYSIS_CONNECTIONS = 1; // background writers: motion scores, heatmaps, perceptual hashes
+const DB_READER_CONNECTIONS = 4; // API queries and playback, by priority
 
-const pool = mariadb.createPool({
+const db = createDbPools({
 	host: DB_HOST,
+	port: DB_PORT,
 	user: DB_USER,
 	password: DB_PASSWORD,
 	database: DB_NAME,
-	connectionLimit: 5,
-	port: DB_PORT,
+	writerConnections: DB_WRITER_CONNECTIONS,
+	analysisConnections: DB_ANALYSIS_CONNECTIONS,
+	readerConnections: DB_READER_CONNECTIONS,
 	acquireTimeout: 20000,
+	registry: metrics,
 });
 
-log(`MariaDB pool created (${DB_HOST}/${DB_NAME})`);
+log(
+	`MariaDB pools created (${DB_HOST}/${DB_NAME}, writer: ${DB_WRITER_CONNECTIONS}, ` +
+		`analysis: ${DB_ANALYSIS_CONNECTIONS}, reader: ${DB_READER_CONNECTIONS})`
+);
 
 // Test DB connection and validate index
-pool
-	.getConnection()
-	.then(async (conn) => {
+db.reader
+	.withConnection('interactive', async (conn) => {
 		log('Database connection: OK');
 
 		// Check for timestamp index
@@ -99,18 +302,18 @@ pool
 		} catch (err) {
 			log(`Index check failed: ${err.message}`, 'WARN');
 		}
-
-		conn.end();
 	})
 	.catch((err) => log(`Database connection failed: ${err.message}`, 'ERROR'));
 
 // --- WebSocket Connection Handling ---
 let wsClientCount = 0;
+let wsViewerSeq = 0;
 // camNo -> session
 const playbackSessions = new Map();
 
 wss.on('connection', (ws) => {
 	wsClientCount++;
+	const viewerId = ++wsViewerSeq;
 	log(`WebSocket client connected (Total: ${wsClientCount})`);
 
 	let activeSession = null;
@@ -144,6 +347,7 @@ wss.on('connection', (ws) => {
 				const session = {
 					camNo,
 					ws,
+					requestedAt: performance.now(),
 					startTime: new Date(
 						startTime.year,
 						startTime.month - 1,
@@ -154,6 +358,7 @@ wss.on('connection', (ws) => {
 					),
 					speed: speed || 1.0,
 					fileQueue: [],
+					proxyShown: new Map(),
 					active: true,
 					frameCount: 0,
 					sessionId,
@@ -181,6 +386,69 @@ wss.on('connection', (ws) => {
 				return;
 			}
 
+			// Start Synchronized Group Playback (several cameras, one clock)
+			if (msg.action === 'playback-group-start') {
+				const { startTime, speed } = msg;
+				const cameras = parseCameraList({ camNo: msg.cameras });
+
+				if (!startTime || !startTime.year || !startTime.month || !startTime.day || cameras.length === 0) {
+					ws.send(JSON.stringify({ type: 'error', message: 'Invalid playback parameters.' }));
+					return;
+				}
+				if (cameras.length > MAX_CAMERAS) {
+					ws.send(JSON.stringify({ type: 'error', message: `At most ${MAX_CAMERAS} cameras.` }));
+					return;
+				}
+
+				if (activeSession) {
+					await stopPlayback(activeSession.camNo);
+					activeSession = null;
+				}
+
+				const sessionId = `group_${cameras.join('+')}_${Date.now()}`;
+				const session = {
+					camNo: sessionId, // playbackSessions key; stop/pause/resume treat it like a camera
+					cameras,
+					ws,
+					requestedAt: performance.now(),
+					startTime: new Date(
+						startTime.year,
+						startTime.month - 1,
+						startTime.day,
+						startTime.hour || 0,
+						startTime.minute || 0,
+						startTime.second || 0
+					),
+					speed: speed || 1.0,
+					proxyShown: new Map(),
+					active: true,
+					frameCount: 0,
+					sessionId,
+				};
+
+				playbackSessions.set(sessionId, session);
+				activeSession = session;
+
+				log(
+					`[PLAYBACK] Starting group: ${cameras.join(', ')} from ${session.startTime.toISOString()} (speed: ${
+						session.speed
+					}x)`
+				);
+
+				ws.send(
+					JSON.stringify({
+						type: 'playback-started',
+						camNo: cameras[0],
+						cameras,
+						group: true,
+						startTime: session.startTime.toISOString(),
+					})
+				);
+
+				startGroupPlayback(session);
+				return;
+			}
+
 			//  Stop Playback Command
 			if (msg.action === 'playback-stop') {
 				if (activeSession) {
@@ -194,6 +462,8 @@ wss.on('connection', (ws) => {
 			if (msg.action === 'playback-pause') {
 				if (activeSession) {
 					activeSession.paused = true;
+					// A paused session gives its reader connection back; resume re-opens from the last row
+					if (activeSession.cursor) activeSession.cursor.close();
 					log(`[PLAYBACK] Paused: ${activeSession.camNo}`);
 				}
 				return;
@@ -208,6 +478,28 @@ wss.on('connection', (ws) => {
 				return;
 			}
 
+			// Change speed mid-playback (proxies from PROXY_MIN_SPEED up, full resolution below)
+			if (msg.action === 'playback-speed') {
+				const speed = Number(msg.speed);
+				if (activeSession && speed > 0 && speed <= 64) {
+					activeSession.speed = speed;
+					log(`[PLAYBACK] Speed: ${activeSession.camNo} ${speed}x`);
+				}
+				return;
+			}
+
+			// Viewer focus: unfocused live viewers are the first to lose frames under load
+			if (msg.action === 'focus') {
+				ws.focused = Boolean(msg.focused);
+				return;
+			}
+
+			// Viewer echo of a sampled live frame's display time
+			if (msg.action === 'trace-ack') {
+				tracer.ack(msg, viewerId);
+				return;
+			}
+
 			// Unknown command
 			log(`Unknown WebSocket command: ${msg.action || msg.type}`, 'WARN');
 			ws.send(JSON.stringify({ type: 'error', message: 'Unknown command.' }));
@@ -234,22 +526,75 @@ wss.on('connection', (ws) => {
 });
 
 //  Broadcast Live Frame to All Clients
-function broadcastFrameBinary(camNo, imageBuffer, timestamp) {
+// format: null for BMP frames, or the raw pixel layout (BMP header synthesized here)
+// receivedAt / ingestAt: server epoch ms when the frame header arrived and when it reached ingest
+function broadcastFrameBinary(camNo, imageBuffer, timestamp, format, receivedAt, ingestAt) {
 	if (wss.clients.size === 0) return;
 
-	const header = JSON.stringify({ camNo, timestamp, type: 'live' });
+	const image = format ? bmpParts(format, imageBuffer) : [imageBuffer];
+	const trace = tracer.begin(camNo, timestamp, receivedAt, ingestAt);
+	const header = JSON.stringify({ camNo, timestamp, type: 'live', trace });
 	const headerBuffer = Buffer.from(header);
 	const headerLength = Buffer.alloc(4);
 	headerLength.writeUInt32BE(headerBuffer.length, 0);
-	const payload = Buffer.concat([headerLength, headerBuffer, imageBuffer]);
+	const payload = Buffer.concat([headerLength, headerBuffer, ...image]);
 
 	wss.clients.forEach((client) => {
 		if (client.readyState === 1) {
+			if (shedder.skipLiveFrame(client)) return;
 			client.send(payload);
 		}
 	});
 }
 
+// Coalesced, cached GET /api/frames results
+const framesCache = new QueryCache({ ttlMs: FRAMES_CACHE_TTL_MS, maxEntries: FRAMES_CACHE_MAX_ENTRIES });
+// GET /api/timeline results (tb_rollup), invalidated the same way
+const timelineCache = new QueryCache({ ttlMs: FRAMES_CACHE_TTL_MS, maxEntries: FRAMES_CACHE_MAX_ENTRIES });
+// Rendered GET /api/contactsheet images
+const sheetCache = new QueryCache({ ttlMs: SHEET_CACHE_TTL_MS, maxEntries: SHEET_CACHE_MAX_ENTRIES });
+
+// tb_rollup must exist (and be backfilled) before the batcher adds to it; without it only tb_index is written,
+// and the first such batch invalidates tb_rollup so the next start rebuilds it
+let rollupsEnabled = false;
+let rollupsInvalidated = false;
+const rollupsReady = db.writer
+	.withConnection(ensureRollupTable)
+	.then((backfilled) => {
+		rollupsEnabled = true;
+		log(backfilled ? 'Timeline rollups: backfilled tb_rollup from tb_index' : 'Timeline rollups: OK');
+	})
+	.catch((err) => log(`Timeline rollups disabled: ${err.message}`, 'WARN'));
+
+// Hourly activity heatmaps, fed by the motion index's changed-cell masks
+const heatmaps = new HeatmapStore({ writer: db.analysis, cols: MOTION_GRID_COLS, rows: MOTION_GRID_ROWS });
+heatmaps
+	.init()
+	.then(() => log('Heatmaps: OK'))
+	.catch((err) => log(`Heatmaps disabled: ${err.message}`, 'WARN'));
+
+// Perceptual hashes of the motion index's luma grids, searched in memory
+const similar = new SimilarityIndex({ writer: db.analysis, reader: db.reader, registry: metrics });
+similar
+	.init()
+	.then(() => similar.load())
+	.then((count) => log(`Similarity index: OK (${count} frames)`))
+	.catch((err) => log(`Similarity index disabled: ${err.message}`, 'WARN'));
+
+// Per-frame motion scores, computed on the image workers after each frame is stored
+const motion = new MotionIndex({
+	pool: imagePool,
+	shedder,
+	writer: db.analysis,
+	registry: metrics,
+	onDiff: ({ camNo, timestamp, changed }) => heatmaps.add(camNo, timestamp, changed),
+	onGrid: ({ camNo, timestamp, grid }) => similar.add(camNo, timestamp, grid, MOTION_GRID_COLS, MOTION_GRID_ROWS),
+});
+motion
+	.init()
+	.then(() => log('Motion index: OK'))
+	.catch((err) => log(`Motion index disabled: ${err.message}`, 'WARN'));
+
 //  Event-Driven DB Insert Queue
 const dbEvents = new EventEmitter();
 let dbInsertQueue = [];
@@ -275,6 +620,7 @@ async function flushDbBatch() {
 	}
 
 	const batch = dbInsertQueue.splice(0, DB_BATCH_SIZE);
+	const batchStart = performance.now();
 
 	const values = batch
 		.map((t) => {
@@ -293,18 +639,46 @@ async function flushDbBatch() {
 		VALUES ${values};
 	`;
 
-	let conn;
 	try {
-		conn = await pool.getConnection();
-		await conn.query(query);
+		await rollupsReady;
+		await db.writer.withConnection(async (conn) => {
+			if (!rollupsEnabled) {
+				if (!rollupsInvalidated) {
+					await invalidateRollups(conn);
+					rollupsInvalidated = true;
+				}
+				return conn.query(query);
+			}
+			// Index rows and their rollup counters commit (or retry) together
+			const rollup = rollupUpsert(batch);
+			await conn.beginTransaction();
+			try {
+				await conn.query(query);
+				await conn.query(rollup.sql, rollup.params);
+				await conn.commit();
+			} catch (err) {
+				await conn.rollback().catch(() => {});
+				throw err;
+			}
+		});
 		totalDbInserts += batch.length;
+
+		const now = performance.now();
+		mDbBatch.observe((now - batchStart) / 1000);
+		mDbRows.inc(batch.length);
+		mFramesCacheInvalidated.inc(framesCache.invalidate(batch));
+		timelineCache.invalidate(batch);
+		sheetCache.invalidate(batch);
+		for (const t of batch) {
+			if (t.ingestedAt) cameraMetrics(t.camNo).durable.observe((now - t.ingestedAt) / 1000);
+		}
+
 		log(`DB: Inserted ${batch.length} records (Total: ${totalDbInserts})`);
 	} catch (err) {
+		mDbErrors.inc();
 		log(`DB insert error: ${err.message}`, 'ERROR');
 		dbInsertQueue = batch.concat(dbInsertQueue);
 		setTimeout(flushDbBatch, 2000);
-	} finally {
-		if (conn) conn.end();
 	}
 }
 
@@ -323,17 +697,33 @@ async function processStorageQueue() {
 		const filePath = path.join(BMP_FOLDER, task.filename);
 
 		try {
-			await fs.writeFile(filePath, task.imageBuffer);
+			if (task.format) {
+				// Raw pixel planes are stored untouched behind a small layout header
+				const file = await fs.open(filePath, 'w');
+				try {
+					await file.writev([makeRawHeader(task.format), task.imageBuffer]);
+				} finally {
+					await file.close();
+				}
+			} else {
+				await fs.writeFile(filePath, task.imageBuffer);
+			}
 			totalFilesSaved++;
+			proxies.submit(task.filename, filePath);
+			motion.submit(task.camNo, task.timestamp, filePath);
 
 			// Queue DB insert
 			dbEvents.emit('enqueue', {
 				camNo: task.camNo,
+				ingestedAt: task.ingestedAt,
 				timestamp: task.timestamp,
 				imgPath: path.relative(process.cwd(), filePath).replace(/\\/g, '/'),
 			});
 		} catch (err) {
 			log(`Storage error: ${task.filename} - ${err.message}`, 'ERROR');
+		} finally {
+			// Shared-memory frames hand their slot back once the bytes are on disk
+			if (task.release) task.release();
 		}
 	}
 
@@ -342,82 +732,116 @@ async function processStorageQueue() {
 
 setInterval(processStorageQueue, 700);
 
+// Recent frames, served to playback and /api/frame-file ahead of the index
+const recentFrames = new FrameRing({
+	windowMs: RECENT_WINDOW_MS,
+	maxBytes: RECENT_MAX_BYTES_PER_CAMERA,
+	maxTotalBytes: RECENT_MAX_BYTES,
+});
+
+function rememberFrame(camNo, filename, timestamp, format, imageBuffer, owned) {
+	// Shared-memory slots are recycled and parser chunks may hold several frames:
+	// keep a private copy unless the buffer is already exclusively this frame's
+	const exclusive = owned && imageBuffer.byteOffset === 0 && imageBuffer.buffer.byteLength === imageBuffer.length;
+	recentFrames.add({
+		camNo,
+		filename,
+		timestamp,
+		format,
+		imageBuffer: exclusive ? imageBuffer : Buffer.from(imageBuffer),
+	});
+}
+
+// Common ingest path for every camera transport (TCP, shared memory)
+// transport: 'tcp' | 'shm' (metrics label)
+// receivedAt: epoch ms when the transport saw the frame's first byte (trace context)
+// format: null for BMP, or { codec, width, height, stride } for raw pixels
+// release: optional callback invoked once imageBuffer is no longer referenced
+function ingestFrame({ camNo, transport, filename, timestamp, format, imageBuffer, release, receivedAt }) {
+	const storedName = storedFrameName(camNo, format ? rawFileName(filename) : filename);
+	const ingestAt = Date.now();
+	timestamp = Number(timestamp);
+
+	const camMetrics = cameraMetrics(camNo);
+	const ingestMetrics = camMetrics.ingest[transport];
+	ingestMetrics.frames.inc();
+	ingestMetrics.bytes.inc(imageBuffer.length);
+
+	// Broadcast to live viewers
+	broadcastFrameBinary(camNo, imageBuffer, timestamp, format, receivedAt || ingestAt, ingestAt);
+
+	rememberFrame(camNo, storedName, timestamp, format, imageBuffer, !release);
+
+	// Queue for storage
+	if (storageQueue.length < STORAGE_QUEUE_MAX) {
+		storageQueue.push({
+			camNo,
+			filename: storedName,
+			timestamp: new Date(timestamp),
+			ingestedAt: performance.now(),
+			format,
+			imageBuffer,
+			release,
+		});
+		// A shared-memory slot stays busy until its frame is on disk: with only
+		// SHM_SLOT_COUNT of them, waiting for the timer would cap each camera's rate
+		if (release) processStorageQueue();
+	} else {
+		camMetrics.dropped.inc();
+		log(`Storage queue full! Dropping frame`, 'WARN');
+		if (release) release();
+	}
+}
+
 // TCP Socket Server (Camera -> Node)
 const tcpServer = net.createServer((socket) => {
 	log('Camera connected via TCP');
 
-	let buffer = Buffer.alloc(0);
-	let waitingForMetadata = true;
-	let metadataLength = 0;
-	let metadata = null;
 	let frameCount = 0;
 	let statsStart = Date.now();
 	let statsBytes = 0;
 
-	socket.on('data', (data) => {
-		buffer = Buffer.concat([buffer, data]);
-		statsBytes += data.length;
+	// Advertise supported protocol versions; v1 clients simply never read this
+	socket.write(makeBanner());
 
-		while (true) {
-			// Read metadata length
-			if (waitingForMetadata) {
-				if (buffer.length < 4) break;
-				metadataLength = buffer.readUInt32BE(0);
-				buffer = buffer.slice(4);
-				waitingForMetadata = false;
-			}
-
-			// Read metadata JSON
-			if (!metadata && buffer.length >= metadataLength) {
-				const metadataJson = buffer.slice(0, metadataLength).toString('utf-8');
-				metadata = JSON.parse(metadataJson);
-				buffer = buffer.slice(metadataLength);
-			}
+	const parser = new IngestParser((frame) => {
+		frameCount++;
 
-			// Read frame bytes
-			if (metadata && buffer.length >= metadata.size) {
-				const imageBuffer = buffer.slice(0, metadata.size);
-				buffer = buffer.slice(metadata.size);
-
-				frameCount++;
-
-				// Broadcast to live viewers
-				broadcastFrameBinary(metadata.camNo, imageBuffer, metadata.timestamp);
+		ingestFrame({
+			camNo: frame.camNo,
+			transport: 'tcp',
+			receivedAt: frame.receivedAt,
+			filename: frame.filename || makeFilenameFromTimestamp(frame.timestamp),
+			timestamp: frame.timestamp,
+			format: frame.format,
+			imageBuffer: frame.imageBuffer,
+		});
 
-				// Queue for storage
-				if (storageQueue.length < STORAGE_QUEUE_MAX) {
-					storageQueue.push({
-						camNo: metadata.camNo,
-						filename: metadata.filename,
-						timestamp: new Date(metadata.timestamp),
-						imageBuffer: imageBuffer,
-					});
-				} else {
-					log(`Storage queue full! Dropping frame`, 'WARN');
-				}
+		// Log stats every 10 frames
+		if (frameCount % 10 === 0) {
+			const elapsed = (Date.now() - statsStart) / 1000;
+			const fps = 10 / elapsed;
+			const avgSize = statsBytes / 10 / 1024;
+			log(
+				`Frame ${frameCount} | FPS: ${fps.toFixed(1)} | ` +
+					`Size: ${avgSize.toFixed(0)}KB | ` +
+					`Protocol: v${frame.version} | ` +
+					`Storage Q: ${storageQueue.length} | ` +
+					`DB Q: ${dbInsertQueue.length}`
+			);
+			statsStart = Date.now();
+			statsBytes = 0;
+		}
+	});
 
-				// Log stats every 10 frames
-				if (frameCount % 10 === 0) {
-					const elapsed = (Date.now() - statsStart) / 1000;
-					const fps = 10 / elapsed;
-					const avgSize = statsBytes / 10 / 1024;
-					log(
-						`Frame ${frameCount} | FPS: ${fps.toFixed(1)} | ` +
-							`Size: ${avgSize.toFixed(0)}KB | ` +
-							`Storage Q: ${storageQueue.length} | ` +
-							`DB Q: ${dbInsertQueue.length}`
-					);
-					statsStart = Date.now();
-					statsBytes = 0;
-				}
+	socket.on('data', (data) => {
+		statsBytes += data.length;
 
-				// Reset for next frame
-				waitingForMetadata = true;
-				metadataLength = 0;
-				metadata = null;
-			} else {
-				break;
-			}
+		try {
+			parser.push(data);
+		} catch (err) {
+			log(`TCP protocol error: ${err.message} - dropping connection`, 'ERROR');
+			socket.destroy();
 		}
 	});
 
@@ -449,8 +873,17 @@ function makeFilenameFromTimestamp(ts) {
 	return `${yy}${MM}${dd}${hh}${mm}${ss}_${ms}.bmp`;
 }
 
+// File name a frame is stored (and remembered, and proxied) under: the sender's name prefixed with camNo,
+// so cameras capturing in the same millisecond never share a file. Characters that can't go in a file
+// name are escaped as ~xxxx (hex code unit); the stem stays at the end for proxyStore.js and columnar.js.
+function storedFrameName(camNo, filename) {
+	const tag = String(camNo).replace(/[^A-Za-z0-9_-]/g, (c) => '~' + c.charCodeAt(0).toString(16).padStart(4, '0'));
+	return `${tag}_${path.basename(filename)}`;
+}
+
 // ---- POST /api/frames
 // Body (JSON): { camNo: "CAM0", timestamp: 1730123456789, filename?: "yyMMddhhmmss_ms.bmp", imageBase64: "<base64>" }
+// The frame is stored as <camNo>_<filename> (see storedFrameName); the response carries that name.
 
 app.post('/api/frames', (req, res) => {
 	try {
@@ -466,22 +899,36 @@ app.post('/api/frames', (req, res) => {
 			return res.status(400).json({ error: 'camNo, timestamp and imageBase64 are required' });
 		}
 
+		if (shedder.rejectPost()) {
+			res.setHeader('Retry-After', '2');
+			return res.status(429).json({ error: 'Server overloaded. Try again later.' });
+		}
+
 		if (storageQueue.length >= STORAGE_QUEUE_MAX) {
+			cameraMetrics(String(camNo)).dropped.inc();
 			log(`Storage queue full (POST) - rejecting`, 'WARN');
 			return res.status(429).json({ error: 'Storage queue full. Try again later.' });
 		}
 
-		const finalFilename =
-			filename && typeof filename === 'string' ? filename : makeFilenameFromTimestamp(timestamp);
+		const finalFilename = storedFrameName(
+			camNo,
+			filename && typeof filename === 'string' ? filename : makeFilenameFromTimestamp(timestamp)
+		);
 
 		const item = {
 			camNo: String(camNo),
 			filename: finalFilename,
 			timestamp: new Date(Number(timestamp)),
+			ingestedAt: performance.now(),
 			imageBuffer: Buffer.from(imageBase64, 'base64'),
 		};
 
+		const postMetrics = cameraMetrics(item.camNo).ingest.post;
+		postMetrics.frames.inc();
+		postMetrics.bytes.inc(item.imageBuffer.length);
+
 		storageQueue.push(item);
+		rememberFrame(item.camNo, finalFilename, Number(timestamp), null, item.imageBuffer, true);
 
 		log(`POST /api/frames: queued ${finalFilename} (Queue: ${storageQueue.length})`);
 		return res.json({
@@ -496,234 +943,778 @@ app.post('/api/frames', (req, res) => {
 });
 
 // ---- GET /api/frames
-// Query options:
+// Query options (see framesQuery.js):
 //  - camNo (required)
 //  - timestamp (epoch ms)  OR  start (epoch ms) & end (epoch ms)
 //  - OR year, month, day, hour, minute, second
+// Identical concurrent queries share one DB round trip; results are cached until
+// the DB batcher inserts rows they cover (X-Cache: hit | miss | coalesced).
+// With `Accept: application/x-ndjson` or `stream=1` rows are streamed one JSON object
+// per line straight from a DB cursor, without the row cap.
+// `format=columnar` answers one camNo plus delta-encoded timestamps and location
+// template ids (see columnar.js); add `binary=1` or `Accept: application/octet-stream`
+// for the little-endian typed-array payload.
+// camNo may list several cameras (camNo=CAM0,CAM1 or repeated): their index scans run
+// in parallel and rows come back merged in global time order (see frameMerge.js).
 
 app.get('/api/frames', async (req, res) => {
-	let conn;
 	try {
-		const camNo = req.query.camNo;
-		if (!camNo) return res.status(400).json({ error: 'camNo is required' });
-
-		const ts = req.query.timestamp ? Number(req.query.timestamp) : null;
-		const start = req.query.start ? Number(req.query.start) : null;
-		const end = req.query.end ? Number(req.query.end) : null;
-
-		const fieldsFromMs = (ms) => {
-			const d = new Date(ms);
-			return {
-				year: d.getFullYear(),
-				mon: d.getMonth() + 1,
-				mday: d.getDate(),
-				hour: d.getHours(),
-				min: d.getMinutes(),
-				sec: d.getSeconds(),
-				mill: d.getMilliseconds(),
-			};
-		};
+		const streaming = req.query.stream === '1' || (req.get('Accept') || '').includes('application/x-ndjson');
+		const cameras = parseCameraList(req.query);
+		if (cameras.length > MAX_CAMERAS) return res.status(400).json({ error: `At most ${MAX_CAMERAS} cameras` });
+		if (cameras.length > 1) return await mergedFrames(cameras, streaming, req, res);
 
-		let query = `
-			SELECT camNo, t_year, t_mon, t_mday, t_hour, t_min, t_sec, t_mill, l_location
-			FROM tb_index
-			WHERE camNo = ?
-		`;
-		const params = [String(camNo)];
-
-		if (ts) {
-			const f = fieldsFromMs(ts);
-			query += ` AND t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour = ? AND t_min = ? AND t_sec = ? `;
-			params.push(f.year, f.mon, f.mday, f.hour, f.min, f.sec);
-		} else if (start && end) {
-			const s = fieldsFromMs(start);
-			const e = fieldsFromMs(end);
-
-			query += `
-        AND (
-            (t_year > ?) OR
-            (t_year = ? AND t_mon > ?) OR
-            (t_year = ? AND t_mon = ? AND t_mday > ?) OR
-            (t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour > ?) OR
-            (t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour = ? AND t_min > ?) OR
-            (t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour = ? AND t_min = ? AND t_sec > ?) OR
-            (t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour = ? AND t_min = ? AND t_sec = ? AND t_mill >= ?)
-        )
-        AND (
-            (t_year < ?) OR
-            (t_year = ? AND t_mon < ?) OR
-            (t_year = ? AND t_mon = ? AND t_mday < ?) OR
-            (t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour < ?) OR
-            (t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour = ? AND t_min < ?) OR
-            (t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour = ? AND t_min = ? AND t_sec < ?) OR
-            (t_year = ? AND t_mon = ? AND t_mday = ? AND t_hour = ? AND t_min = ? AND t_sec = ? AND t_mill <= ?)
-        )
-    `;
-
-			params.push(
-				// Start (>=)
-				s.year,
-				s.year,
-				s.mon,
-				s.year,
-				s.mon,
-				s.mday,
-				s.year,
-				s.mon,
-				s.mday,
-				s.hour,
-				s.year,
-				s.mon,
-				s.mday,
-				s.hour,
-				s.min,
-				s.year,
-				s.mon,
-				s.mday,
-				s.hour,
-				s.min,
-				s.sec,
-				s.year,
-				s.mon,
-				s.mday,
-				s.hour,
-				s.min,
-				s.sec,
-				s.mill,
-
-				// End (<=)
-				e.year,
-				e.year,
-				e.mon,
-				e.year,
-				e.mon,
-				e.mday,
-				e.year,
-				e.mon,
-				e.mday,
-				e.hour,
-				e.year,
-				e.mon,
-				e.mday,
-				e.hour,
-				e.min,
-				e.year,
-				e.mon,
-				e.mday,
-				e.hour,
-				e.min,
-				e.sec,
-				e.year,
-				e.mon,
-				e.mday,
-				e.hour,
-				e.min,
-				e.sec,
-				e.mill
-			);
-		} else {
-			const qYear = req.query.year ? Number(req.query.year) : null;
-			const qMon = req.query.month ? Number(req.query.month) : null;
-			const qDay = req.query.day ? Number(req.query.day) : null;
-			const qHour = req.query.hour ? Number(req.query.hour) : null;
-			const qMin = req.query.minute ? Number(req.query.minute) : null;
-			const qSec = req.query.second ? Number(req.query.second) : null;
-
-			if (qYear) {
-				query += ` AND t_year = ? `;
-				params.push(qYear);
-			}
-			if (qMon) {
-				query += ` AND t_mon = ? `;
-				params.push(qMon);
-			}
-			if (qDay) {
-				query += ` AND t_mday = ? `;
-				params.push(qDay);
-			}
-			if (qHour) {
-				query += ` AND t_hour = ? `;
-				params.push(qHour);
-			}
-			if (qMin) {
-				query += ` AND t_min = ? `;
-				params.push(qMin);
+		const query = buildFramesQuery(req.query, { limit: streaming ? null : undefined });
+		if (query.error) return res.status(400).json({ error: query.error });
+
+		if (streaming) return streamFrames(query, req, res);
+
+		const { rows, source } = await framesCache.get(query, () =>
+			db.reader.withConnection('interactive', (conn) => conn.query(query.sql, query.params))
+		);
+		mFramesCache[source].inc();
+
+		res.setHeader('X-Cache', source);
+		if (req.query.format === 'columnar') {
+			const binary = req.query.binary === '1' || (req.get('Accept') || '').includes('application/octet-stream');
+			const body = encodeColumnar(query.camNo, rows, binary);
+			if (!binary) return res.json(body);
+			res.setHeader('Content-Type', 'application/octet-stream');
+			return res.end(body);
+		}
+		return res.json({ count: rows.length, frames: rows });
+	} catch (err) {
+		log(`GET /api/frames error: ${err.message}`, 'ERROR');
+		return res.status(500).json({ error: 'Internal server error' });
+	}
+});
+
+// Several cameras: one paged scan each, k-way merged. Capped responses are cached like single-camera ones.
+async function mergedFrames(cameras, streaming, req, res) {
+	const queries = cameras.map((camNo) => buildFramesQuery({ ...req.query, camNo }));
+	if (queries[0].error) return res.status(400).json({ error: queries[0].error });
+	if (req.query.format === 'columnar') {
+		return res.status(400).json({ error: 'format=columnar takes a single camNo' });
+	}
+
+	const scans = () =>
+		cameras.map(
+			(camNo) =>
+				new PagedScan((bound, limit) => {
+					const page = buildFramesQuery({ ...req.query, camNo }, { limit, ...bound });
+					return db.reader.withConnection('interactive', (conn) => conn.query(page.sql, page.params));
+				}, FRAMES_MERGE_PAGE_SIZE)
+		);
+
+	if (streaming) return streamMergedFrames(cameras, scans(), req, res);
+
+	const merged = {
+		key: queries.map((q) => q.key).join('+'),
+		matches: (camNo, date) => queries.some((q) => q.matches(camNo, date)),
+	};
+	const { rows, source } = await framesCache.get(merged, async () => {
+		const rows = [];
+		for await (const row of mergeFrames(scans(), { limit: FRAMES_LIMIT })) rows.push(row);
+		return rows;
+	});
+	mFramesCache[source].inc();
+
+	res.setHeader('X-Cache', source);
+	return res.json({ count: rows.length, cameras, frames: rows });
+}
+
+async function streamMergedFrames(cameras, scans, req, res) {
+	res.status(200);
+	res.setHeader('Content-Type', 'application/x-ndjson');
+	res.setHeader('Cache-Control', 'no-store');
+	res.flushHeaders();
+
+	let closed = false;
+	res.on('close', () => (closed = true));
+
+	let rows = 0;
+	const started = Date.now();
+	try {
+		for await (const row of mergeFrames(scans)) {
+			if (closed) break; // client went away: stop paging
+			rows++;
+			if (!res.write(JSON.stringify(row) + '\n')) {
+				await new Promise((resolve) => {
+					res.once('drain', resolve);
+					res.once('close', resolve);
+				});
 			}
-			if (qSec) {
-				query += ` AND t_sec = ? `;
-				params.push(qSec);
+		}
+		if (!res.writableEnded) res.end();
+		log(`GET /api/frames stream: ${rows} rows in ${Date.now() - started}ms (${cameras.join(',')})`);
+	} catch (err) {
+		log(`GET /api/frames stream error: ${err.message}`, 'ERROR');
+		if (!res.writableEnded) res.end(JSON.stringify({ error: 'Internal server error' }) + '\n');
+	}
+}
+
+// NDJSON response fed by a DB cursor; the cursor pauses whenever the socket is backed up
+function streamFrames(query, req, res) {
+	res.status(200);
+	res.setHeader('Content-Type', 'application/x-ndjson');
+	res.setHeader('Cache-Control', 'no-store');
+	res.flushHeaders();
+
+	let rows = 0;
+	const started = Date.now();
+	const cursor = new QueryCursor(db.reader, 'interactive', query.sql, query.params, {
+		onRow: (row) => {
+			rows++;
+			if (!res.write(JSON.stringify(row) + '\n')) cursor.pause();
+		},
+		onClose: (err) => {
+			if (err) {
+				log(`GET /api/frames stream error: ${err.message}`, 'ERROR');
+				// Status is already sent: report in-band as the last line
+				if (!res.writableEnded) res.end(JSON.stringify({ error: 'Internal server error' }) + '\n');
+				return;
 			}
+			if (!res.writableEnded) res.end();
+			log(`GET /api/frames stream: ${rows} rows in ${Date.now() - started}ms (${query.camNo})`);
+		},
+	});
+
+	res.on('drain', () => cursor.resume());
+	res.on('close', () => cursor.close()); // client went away: stop reading
+	cursor.open();
+}
+
+// ---- GET /api/frames/nearest
+// Query: ?camNo=CAM0&ts=<epoch ms>&dir=before|after|nearest (default nearest)
+// The closest frame at or before / at or after ts, by index seek. JSON { frame, offsetMs } by default;
+// with &image=1 the frame image itself, metadata in X-Frame-* headers (&format=raw, &proxy=1 as for /api/frame-file).
+
+app.get('/api/frames/nearest', async (req, res) => {
+	try {
+		const query = buildNearestQuery(req.query);
+		if (query.error) return res.status(400).json({ error: query.error });
+
+		const results = await db.reader.withConnection('interactive', (conn) =>
+			Promise.all(query.seeks.map((seek) => conn.query(seek.sql, seek.params)))
+		);
+
+		let best = null;
+		for (const [row] of results) {
+			if (!row) continue;
+			const { t_year, t_mon, t_mday, t_hour, t_min, t_sec, t_mill } = row;
+			const ts = new Date(t_year, t_mon - 1, t_mday, t_hour, t_min, t_sec, t_mill).getTime();
+			// Equal distance: the earlier frame (seeks run before-first)
+			if (!best || Math.abs(ts - query.ts) < Math.abs(best.ts - query.ts)) best = { row, ts };
+		}
+		if (!best) return res.status(404).json({ error: 'No frame found' });
+
+		const offsetMs = best.ts - query.ts;
+		if (req.query.image !== '1') {
+			return res.json({
+				camNo: query.camNo,
+				ts: query.ts,
+				dir: query.dir,
+				offsetMs,
+				frame: { ...best.row, timestamp: best.ts },
+			});
 		}
 
-		query += ` ORDER BY t_year, t_mon, t_mday, t_hour, t_min, t_sec, t_mill LIMIT 5000;`;
+		res.setHeader('X-Frame-CamNo', query.camNo);
+		res.setHeader('X-Frame-Timestamp', String(best.ts));
+		res.setHeader('X-Frame-Offset-Ms', String(offsetMs));
+		res.setHeader('X-Frame-Location', best.row.l_location);
+		return await sendFrameFile(req, res, best.row.l_location);
+	} catch (err) {
+		log(`GET /api/frames/nearest error: ${err.message}`, 'ERROR');
+		return res.status(500).json({ error: 'Internal server error' });
+	}
+});
 
-		conn = await pool.getConnection();
-		const rows = await conn.query(query, params);
+// ---- GET /api/timeline
+// Query: ?camNo=CAM0&grain=minute|hour|day (default hour)
+//   &start=<epoch ms>&end=<epoch ms>  OR  &year=2025&month=11[&day=10[&hour=12]]
+// Frame counts per bucket from tb_rollup (see rollups.js). Buckets without footage are
+// omitted; each entry is [bucket, frames, firstTs, lastTs] in wall-clock ms.
 
-		return res.json({ count: rows.length, frames: rows });
+app.get('/api/timeline', async (req, res) => {
+	try {
+		const query = buildTimelineQuery(req.query);
+		if (query.error) return res.status(400).json({ error: query.error });
+		if (!rollupsEnabled) return res.status(503).json({ error: 'Timeline rollups unavailable' });
+
+		const { rows, source } = await timelineCache.get(query, () =>
+			db.reader.withConnection('interactive', (conn) => conn.query(query.sql, query.params))
+		);
+
+		res.setHeader('X-Cache', source);
+		return res.json({
+			camNo: query.camNo,
+			grain: query.grain,
+			start: query.start,
+			end: query.end,
+			buckets: rows.map((r) => [Number(r.bucket), r.frames, Number(r.first_ts), Number(r.last_ts)]),
+		});
 	} catch (err) {
-		log(`GET /api/frames error: ${err.message}`, 'ERROR');
+		log(`GET /api/timeline error: ${err.message}`, 'ERROR');
+		return res.status(500).json({ error: 'Internal server error' });
+	}
+});
+
+// ---- GET /api/contactsheet
+// Query: ?camNo=CAM0&start=<epoch ms>&end=<epoch ms>[&n=24][&w=160][&format=bmp|jpeg]
+// One image grid of n frames spread evenly over the range (see contactSheet.js), row by row.
+// X-Contact-Sheet-Grid: <cols>x<rows>; X-Contact-Sheet-Timestamps: each cell's frame time (empty: no footage).
+
+app.get('/api/contactsheet', async (req, res) => {
+	try {
+		const sheet = buildContactSheetQuery(req.query);
+		if (sheet.error) return res.status(400).json({ error: sheet.error });
+
+		const { rows: result, source } = await sheetCache.get(sheet, () => renderContactSheet(sheet));
+
+		res.setHeader('X-Cache', source);
+		res.setHeader('X-Contact-Sheet-Grid', `${result.cols}x${result.rows}`);
+		res.setHeader('X-Contact-Sheet-Timestamps', result.timestamps.join(','));
+		res.setHeader('Content-Type', result.mime);
+		return res.end(result.image);
+	} catch (err) {
+		log(`GET /api/contactsheet error: ${err.message}`, 'ERROR');
+		return res.status(500).json({ error: 'Internal server error' });
+	}
+});
+
+async function renderContactSheet(sheet) {
+	const found = await db.reader.withConnection('interactive', (conn) =>
+		Promise.all(sheet.slots.map((slot) => conn.query(slot.seek.sql, slot.seek.params)))
+	);
+	const frames = found.map(([row], i) => {
+		if (!row) return null;
+		const { t_year, t_mon, t_mday, t_hour, t_min, t_sec, t_mill } = row;
+		const ts = new Date(t_year, t_mon - 1, t_mday, t_hour, t_min, t_sec, t_mill).getTime();
+		return ts < sheet.slots[i].to ? { row, ts } : null; // first frame is already in a later slot
+	});
+
+	// Scaled on the image workers, from proxies where they exist; a failed tile leaves its cell black
+	const tiles = await Promise.all(
+		frames.map(async (frame) => {
+			if (!frame) return null;
+			try {
+				const jpeg = await proxies.get(frame.row.l_location);
+				const task = { op: 'tile', filePath: path.resolve(frame.row.l_location), jpeg, width: sheet.width };
+				const tile = await imagePool.run(task, [], true);
+				return Buffer.from(tile.buffer, tile.byteOffset, tile.length);
+			} catch (err) {
+				log(`[SHEET] ${sheet.camNo}: ${path.basename(frame.row.l_location)} - ${err.message}`, 'WARN');
+				return null;
+			}
+		})
+	);
+
+	const { bmp, cols, rows } = composeContactSheet(tiles);
+	const timestamps = frames.map((frame) => (frame ? frame.ts : ''));
+	if (sheet.format === 'jpeg') {
+		const jpeg = await imagePool.run({ op: 'jpeg', bmp, quality: 80 }, [], true);
+		const image = Buffer.from(jpeg.buffer, jpeg.byteOffset, jpeg.length);
+		return { image, mime: 'image/jpeg', cols, rows, timestamps };
+	}
+	return { image: bmp, mime: 'image/bmp', cols, rows, timestamps };
+}
+
+// ---- GET /api/export
+// Query: ?camNo=CAM0&start=<epoch ms>&end=<epoch ms>[&format=avi|mjpeg][&fps=10][&seekable=1]
+// The range as one download: MJPEG-in-AVI (default) or concatenated JPEGs, streamed as frames are encoded.
+// A streamed AVI has no sizes in its header and plays in ffmpeg-based players only (see aviWriter.js);
+// with &seekable=1 it is built in a temporary file first, header patched, and sent with a Content-Length
+// so Windows Media Foundation and QuickTime accept it.
+
+app.get('/api/export', async (req, res) => {
+	try {
+		const { camNo, start, end } = req.query;
+		if (!camNo || !start || !end) {
+			return res.status(400).json({ error: 'camNo, start & end (epoch ms) are required' });
+		}
+		const format = req.query.format ? String(req.query.format) : 'avi';
+		if (!EXPORT_FORMATS.includes(format)) return res.status(400).json({ error: 'format must be avi or mjpeg' });
+		const fps = req.query.fps ? Number(req.query.fps) : EXPORT_DEFAULT_FPS;
+		if (!Number.isInteger(fps) || fps < 1 || fps > 60) return res.status(400).json({ error: 'fps must be 1-60' });
+
+		const range = { camNo: String(camNo), start: String(start), end: String(end) };
+		const query = buildFramesQuery(range);
+		if (query.error) return res.status(400).json({ error: query.error });
+
+		// Bulk read: index pages and frame files at read-ahead priority
+		const scan = new PagedScan((bound, limit) => {
+			const page = buildFramesQuery(range, { limit, ...bound });
+			return db.reader.withConnection('prefetch', (conn) => conn.query(page.sql, page.params));
+		}, EXPORT_PAGE_SIZE);
+		if (!(await scan.head())) return res.status(404).json({ error: 'No frames in range' });
+
+		if (req.query.seekable === '1' && format === 'avi') return await fileExport(scan, range, fps, res);
+		return await streamExport(scan, range, format, fps, res);
+	} catch (err) {
+		log(`GET /api/export error: ${err.message}`, 'ERROR');
+		if (res.headersSent) return res.end();
 		return res.status(500).json({ error: 'Internal server error' });
+	}
+});
+
+function exportFileName(range, format) {
+	return `${range.camNo}_${range.start}-${range.end}.${format === 'avi' ? 'avi' : 'mjpeg'}`;
+}
+
+function encodeExportFrame(row) {
+	const task = { op: 'frameJpeg', filePath: path.resolve(row.l_location), scale: 1, quality: EXPORT_QUALITY };
+	return imagePool.run(task).then((jpeg) => Buffer.from(jpeg.buffer, jpeg.byteOffset, jpeg.length));
+}
+
+function logExport(range, result, started, closed) {
+	log(
+		`GET /api/export ${range.camNo}: ${result.frames} frames, ${result.skipped} skipped, ` +
+			`${(result.bytes / 1024 / 1024).toFixed(1)}MB in ${Date.now() - started}ms${closed ? ' (client left)' : ''}`
+	);
+}
+
+// Seekable AVI: the whole clip goes to a temporary file, gets its finalized header, then is sent
+async function fileExport(scan, range, fps, res) {
+	let closed = false;
+	res.on('close', () => (closed = true));
+
+	const started = Date.now();
+	const tmpPath = path.join(os.tmpdir(), `export-${process.pid}-${started}-${Math.random().toString(36).slice(2)}.avi`);
+	const file = await fs.open(tmpPath, 'w');
+	try {
+		let result;
+		try {
+			result = await exportClip(mergeFrames([scan]), {
+				format: 'avi',
+				fps,
+				readAhead: EXPORT_READ_AHEAD,
+				encode: encodeExportFrame,
+				write: (buf) => file.write(buf),
+				isOpen: () => !closed,
+				onSkip: (row, err) => log(`[EXPORT] ${range.camNo}: ${path.basename(row.l_location)} - ${err.message}`, 'WARN'),
+			});
+			if (result.header) await file.write(result.header, 0, result.header.length, 0);
+		} finally {
+			await file.close();
+		}
+
+		logExport(range, result, started, closed);
+		if (closed) return;
+		if (!result.header) return res.status(422).json({ error: 'No frame in range could be encoded' });
+
+		res.setHeader('Content-Type', 'video/x-msvideo');
+		res.setHeader('Content-Disposition', `attachment; filename="${exportFileName(range, 'avi')}"`);
+		res.setHeader('Cache-Control', 'no-store');
+		res.setHeader('Content-Length', String(result.bytes));
+		await new Promise((resolve) => {
+			const stream = require('fs').createReadStream(tmpPath);
+			stream.on('error', (err) => {
+				log(`[EXPORT] ${range.camNo}: ${err.message}`, 'ERROR');
+				res.destroy();
+				resolve();
+			});
+			res.on('close', resolve);
+			stream.pipe(res);
+		});
 	} finally {
-		if (conn) conn.end();
+		await fs.unlink(tmpPath).catch(() => {});
+	}
+}
+
+async function streamExport(scan, range, format, fps, res) {
+	const name = exportFileName(range, format);
+	res.status(200);
+	res.setHeader('Content-Type', format === 'avi' ? 'video/x-msvideo' : 'video/x-motion-jpeg');
+	res.setHeader('Content-Disposition', `attachment; filename="${name}"`);
+	res.setHeader('Cache-Control', 'no-store');
+	res.flushHeaders();
+
+	let closed = false;
+	res.on('close', () => (closed = true));
+
+	const started = Date.now();
+	const result = await exportClip(mergeFrames([scan]), {
+		format,
+		fps,
+		readAhead: EXPORT_READ_AHEAD,
+		encode: encodeExportFrame,
+		write: (buf) =>
+			res.write(buf)
+				? Promise.resolve()
+				: new Promise((resolve) => {
+						const done = () => {
+							res.off('drain', done);
+							res.off('close', done);
+							resolve();
+						};
+						res.on('drain', done);
+						res.on('close', done);
+				  }),
+		isOpen: () => !closed,
+		onSkip: (row, err) => log(`[EXPORT] ${range.camNo}: ${path.basename(row.l_location)} - ${err.message}`, 'WARN'),
+	});
+	if (!res.writableEnded) res.end();
+	logExport(range, result, started, closed);
+}
+
+// ---- GET /api/motion/next
+// Query: ?camNo=CAM0&ts=<epoch ms>[&min=2][&dir=after|before]
+// The closest frame past ts whose motion score is at least min percent (tb_motion, see motionIndex.js).
+
+app.get('/api/motion/next', async (req, res) => {
+	try {
+		const query = buildMotionSeekQuery(req.query);
+		if (query.error) return res.status(400).json({ error: query.error });
+		if (!motion.enabled) return res.status(503).json({ error: 'Motion index unavailable' });
+
+		const [row] = await db.reader.withConnection('interactive', (conn) => conn.query(query.sql, query.params));
+		if (!row) return res.status(404).json({ error: 'No motion found' });
+
+		const ts = fromWallClockMs(Number(row.ts));
+		return res.json({ camNo: query.camNo, from: query.ts, dir: query.dir, ts, score: row.score / 10 });
+	} catch (err) {
+		log(`GET /api/motion/next error: ${err.message}`, 'ERROR');
+		return res.status(500).json({ error: 'Internal server error' });
 	}
 });
 
-// ---- GET /api/frame-file
-// Query: ?filename=250201104512_123.bmp  or complete path as well (bmpData/241028185056_789.bmp)
+// ---- GET /api/motion/intervals
+// Query: ?camNo=CAM0&start=<epoch ms>&end=<epoch ms>[&min=2][&gap=2000]
+// Periods of motion: runs of frames scoring at least min percent, split at gaps longer than gap ms.
+// Each entry is [start, end, peakScore, frames] with times in epoch ms.
 
-app.get('/api/frame-file', (req, res) => {
+app.get('/api/motion/intervals', async (req, res) => {
 	try {
-		const filename = req.query.filename || req.query.file || req.query.path;
-		if (!filename) return res.status(400).json({ error: 'filename query param required' });
+		const query = buildMotionIntervalsQuery(req.query);
+		if (query.error) return res.status(400).json({ error: query.error });
+		if (!motion.enabled) return res.status(503).json({ error: 'Motion index unavailable' });
 
-		const fsSync = require('fs');
-		const safeName = path.basename(filename);
-		const fullPath = path.join(BMP_FOLDER, safeName);
+		const rows = await db.reader.withConnection('interactive', (conn) => conn.query(query.sql, query.params));
+		return res.json({
+			camNo: query.camNo,
+			start: query.start,
+			end: query.end,
+			gap: query.gap,
+			intervals: rows.map((r) => [
+				fromWallClockMs(Number(r.start)),
+				fromWallClockMs(Number(r.end)),
+				r.peak / 10,
+				Number(r.frames),
+			]),
+		});
+	} catch (err) {
+		log(`GET /api/motion/intervals error: ${err.message}`, 'ERROR');
+		return res.status(500).json({ error: 'Internal server error' });
+	}
+});
 
-		if (!fsSync.existsSync(fullPath)) {
-			return res.status(404).json({ error: 'File not found' });
+// ---- GET /api/heatmap
+// Query: ?camNo=CAM0&start=<epoch ms>&end=<epoch ms>[&format=json|bmp][&scale=10]
+// Where in the picture motion happened: the hourly grids of every hour touching the range, summed
+// (see heatmaps.js). JSON gives per-cell frame counts, top row first; bmp renders them, scale px per cell.
+
+app.get('/api/heatmap', async (req, res) => {
+	try {
+		const query = heatmaps.buildQuery(req.query);
+		if (query.error) return res.status(400).json({ error: query.error });
+		const format = req.query.format ? String(req.query.format) : 'json';
+		if (format !== 'json' && format !== 'bmp') return res.status(400).json({ error: 'format must be json or bmp' });
+		const scale = req.query.scale ? Number(req.query.scale) : 10;
+		if (!Number.isInteger(scale) || scale < 1 || scale > 40) return res.status(400).json({ error: 'scale must be 1-40' });
+		if (!heatmaps.enabled) return res.status(503).json({ error: 'Heatmaps unavailable' });
+
+		const rows = await db.reader.withConnection('interactive', (conn) => conn.query(query.sql, query.params));
+		const { hours, frames, grid } = heatmaps.sum(query, rows);
+
+		if (format === 'bmp') {
+			res.setHeader('Content-Type', 'image/bmp');
+			res.setHeader('X-Heatmap-Frames', String(frames));
+			return res.end(renderHeatmap(grid, MOTION_GRID_COLS, MOTION_GRID_ROWS, scale));
 		}
+		return res.json({
+			camNo: query.camNo,
+			start: query.start,
+			end: query.end,
+			cols: MOTION_GRID_COLS,
+			rows: MOTION_GRID_ROWS,
+			hours,
+			frames,
+			grid: Array.from(grid),
+		});
+	} catch (err) {
+		log(`GET /api/heatmap error: ${err.message}`, 'ERROR');
+		return res.status(500).json({ error: 'Internal server error' });
+	}
+});
 
-		res.setHeader('Content-Type', 'image/bmp');
-		res.setHeader('Content-Disposition', `inline; filename="${safeName}"`);
-		const stream = fsSync.createReadStream(fullPath);
-		stream.on('error', (err) => {
-			log(`Stream error for ${safeName}: ${err.message}`, 'ERROR');
-			res.status(500).end();
+// ---- GET /api/similar
+// Query: ?filename=<stored frame>[&camNo=CAM0][&k=10]
+// ---- POST /api/similar?[camNo=CAM0][&k=10] with a BMP or raw frame as the body (image/bmp or application/octet-stream)
+// The k frames whose perceptual hash is closest to the given image's, on one camera or all (see similarityIndex.js).
+// Each entry is { camNo, timestamp, distance (differing bits of 64), location }; location is null for a frame
+// hashed but not yet in tb_index. `loading` is true while the index is still being read from tb_phash.
+
+app.get('/api/similar', async (req, res) => {
+	if (!req.query.filename) return res.status(400).json({ error: 'filename is required' });
+	const safeName = path.basename(String(req.query.filename));
+
+	const recent = recentFrames.get(safeName) || recentFrames.get(rawFileName(safeName));
+	if (recent) {
+		const bmp = recent.format ? Buffer.concat(bmpParts(recent.format, recent.imageBuffer)) : recent.imageBuffer;
+		return findSimilar(req, res, { bmp });
+	}
+
+	let filePath = path.join(BMP_FOLDER, safeName);
+	if (!(await fileExists(filePath))) filePath = path.join(BMP_FOLDER, rawFileName(safeName));
+	if (!(await fileExists(filePath))) return res.status(404).json({ error: 'File not found' });
+	return findSimilar(req, res, { filePath });
+});
+
+app.post(
+	'/api/similar',
+	express.raw({ type: ['image/bmp', 'application/octet-stream'], limit: '20mb' }),
+	(req, res) => {
+		if (!Buffer.isBuffer(req.body) || req.body.length === 0) return res.status(400).json({ error: 'Image body is required' });
+		return findSimilar(req, res, { bmp: req.body });
+	}
+);
+
+function fileExists(filePath) {
+	return fs.access(filePath).then(
+		() => true,
+		() => false
+	);
+}
+
+// image: { filePath } or { bmp } as the lumaGrid worker op takes it
+async function findSimilar(req, res, image) {
+	try {
+		const k = req.query.k ? Number(req.query.k) : 10;
+		if (!Number.isInteger(k) || k < 1 || k > 100) return res.status(400).json({ error: 'k must be 1-100' });
+		const camNo = req.query.camNo ? String(req.query.camNo) : null;
+		if (!similar.enabled) return res.status(503).json({ error: 'Similarity index unavailable' });
+
+		let grid;
+		try {
+			grid = await imagePool.run(
+				{ op: 'lumaGrid', ...image, cols: MOTION_GRID_COLS, rows: MOTION_GRID_ROWS },
+				[],
+				true
+			);
+		} catch (err) {
+			return res.status(422).json({ error: `Unreadable image: ${err.message}` });
+		}
+
+		const started = process.hrtime.bigint();
+		const hash = dHash(grid, MOTION_GRID_COLS, MOTION_GRID_ROWS);
+		const found = similar.search(hash, k, camNo);
+		const searchMs = Number(process.hrtime.bigint() - started) / 1e6;
+
+		// File locations: one index seek per match
+		const rows = await db.reader.withConnection('interactive', (conn) =>
+			Promise.all(
+				found.map(({ camNo: cam, ts }) => {
+					const [seek] = buildNearestQuery({ camNo: cam, ts, dir: 'after' }).seeks;
+					return conn.query(seek.sql, seek.params);
+				})
+			)
+		);
+
+		return res.json({
+			camNo,
+			k,
+			hash: hash.hi.toString(16).padStart(8, '0') + hash.lo.toString(16).padStart(8, '0'),
+			loading: !similar.loaded,
+			searchMs: Math.round(searchMs * 100) / 100,
+			frames: found.map(({ camNo: cam, ts, distance }, i) => {
+				const [row] = rows[i];
+				const rowTs = row
+					? new Date(row.t_year, row.t_mon - 1, row.t_mday, row.t_hour, row.t_min, row.t_sec, row.t_mill).getTime()
+					: null;
+				return { camNo: cam, timestamp: ts, distance, location: rowTs === ts ? row.l_location : null };
+			}),
 		});
-		stream.pipe(res);
+	} catch (err) {
+		log(`${req.method} /api/similar error: ${err.message}`, 'ERROR');
+		return res.status(500).json({ error: 'Internal server error' });
+	}
+}
+
+// ---- GET /api/traces
+// Query: ?camNo=CAM0 (optional). Most recent sampled glass-to-glass traces, oldest first.
+
+app.get('/api/traces', (req, res) => {
+	const traces = tracer.traces(req.query.camNo ? String(req.query.camNo) : null);
+	return res.json({ sampleRate: TRACE_SAMPLE_RATE, count: traces.length, traces });
+});
+
+// ---- GET /api/frame-file
+// Query: ?filename=CAM0_250201104512_123.bmp  or complete path as well (bmpData/CAM0_241028185056_789.bmp)
+// Raw-transport frames (.raw) are served as BMP unless &format=raw is given
+// &proxy=1 serves the low-resolution JPEG proxy when there is one (scrubbing, thumbnails)
+
+app.get('/api/frame-file', async (req, res) => {
+	try {
+		const filename = req.query.filename || req.query.file || req.query.path;
+		if (!filename) return res.status(400).json({ error: 'filename query param required' });
+
+		return await sendFrameFile(req, res, filename);
 	} catch (err) {
 		log(`GET /api/frame-file error: ${err.message}`, 'ERROR');
 		return res.status(500).json({ error: 'Internal server error' });
 	}
 });
 
+// Frame image by file name: proxy if asked for, memory ring, then disk (.raw frames become BMP unless &format=raw)
+async function sendFrameFile(req, res, filename) {
+	const fsSync = require('fs');
+	const safeName = path.basename(filename);
+
+	if (req.query.proxy === '1') {
+		const jpeg = await proxies.get(safeName);
+		if (jpeg) {
+			res.setHeader('X-Frame-Source', 'proxy');
+			res.setHeader('Content-Type', 'image/jpeg');
+			res.setHeader('Content-Disposition', `inline; filename="${safeName.replace(/\.[^.]*$/, '')}.jpg"`);
+			return res.end(jpeg);
+		}
+	}
+
+	// Recent frames come straight from memory, even before they reach the disk
+	const recent = recentFrames.get(safeName) || recentFrames.get(rawFileName(safeName));
+	if (recent) {
+		res.setHeader('X-Frame-Source', 'memory');
+		if (!recent.format) {
+			res.setHeader('Content-Type', 'image/bmp');
+			res.setHeader('Content-Disposition', `inline; filename="${recent.filename}"`);
+			return res.end(recent.imageBuffer);
+		}
+		if (req.query.format === 'raw') {
+			res.setHeader('Content-Type', 'application/octet-stream');
+			res.setHeader('Content-Disposition', `inline; filename="${recent.filename}"`);
+			return res.end(Buffer.concat([makeRawHeader(recent.format), recent.imageBuffer]));
+		}
+		res.setHeader('Content-Type', 'image/bmp');
+		res.setHeader('Content-Disposition', `inline; filename="${path.basename(recent.filename, '.raw')}.bmp"`);
+		return res.end(Buffer.concat(bmpParts(recent.format, recent.imageBuffer)));
+	}
+
+	let fullPath = path.join(BMP_FOLDER, safeName);
+
+	// A frame that arrived as raw pixels is stored as .raw under the same name
+	if (!fsSync.existsSync(fullPath) && !isRawFile(fullPath)) {
+		const rawPath = path.join(BMP_FOLDER, rawFileName(safeName));
+		if (fsSync.existsSync(rawPath)) fullPath = rawPath;
+	}
+
+	if (!fsSync.existsSync(fullPath)) {
+		return res.status(404).json({ error: 'File not found' });
+	}
+
+	if (isRawFile(fullPath)) {
+		if (req.query.format === 'raw') {
+			res.setHeader('Content-Type', 'application/octet-stream');
+			res.setHeader('Content-Disposition', `inline; filename="${path.basename(fullPath)}"`);
+			return res.sendFile(fullPath);
+		}
+
+		const bmp = frameFileToBmp(await fs.readFile(fullPath));
+		res.setHeader('Content-Type', 'image/bmp');
+		res.setHeader(
+			'Content-Disposition',
+			`inline; filename="${path.basename(fullPath, '.raw')}.bmp"`
+		);
+		return res.end(bmp);
+	}
+
+	res.setHeader('Content-Type', 'image/bmp');
+	res.setHeader('Content-Disposition', `inline; filename="${safeName}"`);
+	const stream = fsSync.createReadStream(fullPath);
+	stream.on('error', (err) => {
+		log(`Stream error for ${safeName}: ${err.message}`, 'ERROR');
+		res.status(500).end();
+	});
+	stream.pipe(res);
+}
+
 // Start Servers
 server.listen(HTTP_PORT, () => {
 	log(`HTTP server: http://localhost:${HTTP_PORT} (live feed)`);
 	log(`Playback UI: http://localhost:${HTTP_PORT}/playback`);
+	log(`Metrics: http://localhost:${HTTP_PORT}/metrics`);
 });
 
 tcpServer.listen(SOCKET_PORT, () => {
 	log(`TCP server listening on port ${SOCKET_PORT}`);
 });
 
+// Shared-memory ring (Camera -> Node, same host)
+const shmTransport = startShmTransport({
+	socketPath: SHM_SOCKET_PATH,
+	slotCount: SHM_SLOT_COUNT,
+	slotSize: SHM_SLOT_SIZE,
+	onFrame: ingestFrame,
+});
+
+// Scrape-time gauges: read live state instead of mirroring it on every change
+metrics.gauge('surveillance_storage_queue_depth', 'Frames waiting to be written to disk', [], (g) =>
+	g.labels().set(storageQueue.length)
+);
+metrics.gauge('surveillance_db_queue_depth', 'Index rows waiting for the next DB batch', [], (g) =>
+	g.labels().set(dbInsertQueue.length)
+);
+metrics.gauge('surveillance_ws_clients', 'Connected WebSocket clients', [], (g) => g.labels().set(wsClientCount));
+metrics.gauge('surveillance_ws_buffered_bytes', 'Bytes queued in all WebSocket send buffers', [], (g) => {
+	let total = 0;
+	wss.clients.forEach((client) => (total += client.bufferedAmount));
+	g.labels().set(total);
+});
+metrics.gauge(
+	'surveillance_playback_ws_buffered_bytes',
+	'Bytes queued in the send buffer of each playback session',
+	['camera'],
+	(g) => {
+		// Ended sessions drop out (group session keys are unique per start)
+		for (const key of [...g.children.keys()]) if (!playbackSessions.has(key)) g.remove(key);
+		playbackSessions.forEach((s, camNo) => g.labels(camNo).set(s.ws.bufferedAmount));
+	}
+);
+metrics.gauge('surveillance_recent_ring_bytes', 'Bytes held in the recent-frame ring', [], (g) =>
+	g.labels().set(recentFrames.stats().bytes)
+);
+metrics.gauge(
+	'surveillance_event_loop_delay_seconds',
+	'Event loop delay since the previous scrape',
+	['quantile'],
+	(g) => {
+		g.labels('0.5').set(eventLoopDelay.percentile(50) / 1e9);
+		g.labels('0.99').set(eventLoopDelay.percentile(99) / 1e9);
+		g.labels('max').set(eventLoopDelay.max / 1e9);
+		eventLoopDelay.reset();
+	}
+);
+
 // Status Report
 setInterval(() => {
 	let playbackInfo = '';
 	if (playbackSessions.size > 0) {
 		playbackSessions.forEach((s, camNo) => {
-			playbackInfo += ` | ${camNo}: ${s.frameCount} sent, Q: ${s.fileQueue.length}`;
+			// Group sessions have no file queue (they read ahead in groupPlayback.js)
+			playbackInfo += ` | ${camNo}: ${s.frameCount} sent` + (s.fileQueue ? `, Q: ${s.fileQueue.length}` : '');
 		});
 	}
 
+	const recent = recentFrames.stats();
+
 	log(
 		`Status | Clients: ${wsClientCount} | ` +
 			`Storage Q: ${storageQueue.length} | ` +
 			`DB Q: ${dbInsertQueue.length} | ` +
 			`Files saved: ${totalFilesSaved} | ` +
-			`DB inserts: ${totalDbInserts}${playbackInfo}`
+			`DB inserts: ${totalDbInserts} | ` +
+			`Shed level: ${shedder.level} | ` +
+			`Recent: ${recent.frames} frames (${(recent.bytes / 1024 / 1024).toFixed(0)}MB)${playbackInfo}`
 	);
 }, 30000);
 
@@ -738,10 +1729,16 @@ process.on('SIGINT', async () => {
 
 	await flushDbBatch();
 	await processStorageQueue();
+	await motion.stop();
+	await heatmaps.stop();
+	await similar.stop();
 
+	shedder.stop();
+	await imagePool.close();
 	tcpServer.close();
+	if (shmTransport) shmTransport.close();
 	server.close();
-	await pool.end();
+	await db.end();
 
 	log('Shutdown complete');
 	process.exit(0);
@@ -749,39 +1746,311 @@ process.on('SIGINT', async () => {
 
 // PLAYBACK MODULE
 
+// tb_index key columns for an epoch-ms timestamp (local time, as stored)
+function rowKeyFromMs(ms) {
+	const d = new Date(ms);
+	return {
+		t_year: d.getFullYear(),
+		t_mon: d.getMonth() + 1,
+		t_mday: d.getDate(),
+		t_hour: d.getHours(),
+		t_min: d.getMinutes(),
+		t_sec: d.getSeconds(),
+		t_mill: d.getMilliseconds(),
+	};
+}
+
 // Stop Playback Session
 async function stopPlayback(camNo) {
 	const session = playbackSessions.get(camNo);
 	if (!session) return;
 
 	session.active = false;
+	if (session.cursor) session.cursor.close();
 	playbackSessions.delete(camNo);
 
 	log(`[PLAYBACK] Session stopped: ${camNo} | Frames sent: ${session.frameCount}`);
 }
 
+// Playback frame image (memory ring first); raw-transport frames get a BMP header
+async function readPlaybackFrame(location) {
+	const recent = recentFrames.get(path.basename(location));
+	if (recent) return recent.format ? Buffer.concat(bmpParts(recent.format, recent.imageBuffer)) : recent.imageBuffer;
+
+	const filePath = path.resolve(location);
+	const imageBuffer = await fs.readFile(filePath);
+	return isRawFile(filePath) ? frameFileToBmp(imageBuffer) : imageBuffer;
+}
+
+// Binary playback message: u32 header length, JSON header, image
+function playbackPayload(header, image) {
+	const headerBuf = Buffer.from(JSON.stringify(header));
+	const headerLen = Buffer.alloc(4);
+	headerLen.writeUInt32BE(headerBuf.length, 0);
+	return Buffer.concat([headerLen, headerBuf, image]);
+}
+
+// Fast playback shows proxies; the frames on screen when it pauses are re-sent at full resolution
+async function refreshPausedFrames(session) {
+	const shown = [...session.proxyShown.values()];
+	session.proxyShown.clear();
+	const images = await Promise.all(
+		shown.map(({ header, location }) =>
+			readPlaybackFrame(location).catch((err) => {
+				log(`[PLAYBACK] ${header.camNo}: Full-resolution refresh failed - ${err.message}`, 'WARN');
+				return null;
+			})
+		)
+	);
+	if (session.ws.readyState !== 1) return;
+	shown.forEach(({ header }, i) => {
+		if (images[i]) session.ws.send(playbackPayload({ ...header, tier: 'full', mime: 'image/bmp' }, images[i]));
+	});
+}
+
+// Synchronized group: one merged schedule and one clock for all cameras (see groupPlayback.js)
+async function startGroupPlayback(session) {
+	const { cameras, sessionId } = session;
+	const startMs = session.startTime.getTime();
+	// Footage up to the moment playback started; live frames after that are for the live view
+	const range = { start: String(startMs), end: String(Date.now()) };
+
+	const scans = cameras.map(
+		(camNo) =>
+			new PagedScan((bound, limit) => {
+				const page = buildFramesQuery({ ...range, camNo }, { limit, ...bound });
+				// The first page is what the viewer is waiting on; later ones are read-ahead
+				return db.reader.withConnection(bound.after || bound.at ? 'prefetch' : 'interactive', (conn) =>
+					conn.query(page.sql, page.params)
+				);
+			}, PLAYBACK_BATCH_SIZE)
+	);
+
+	const flow = new PlaybackFlow(session.ws, { windowBytes: PLAYBACK_SEND_WINDOW_BYTES, decisions: mPlaybackFlow });
+	const started = new Set();
+	let missing = 0;
+	const send = (row, frame, err) => {
+		const { camNo } = row;
+		if (err) {
+			missing++;
+			log(`[PLAYBACK] ${camNo}: File error - ${path.basename(row.l_location)} - ${err.message}`, 'ERROR');
+			if (missing % 5 === 0 && session.ws.readyState === 1) {
+				session.ws.send(
+					JSON.stringify({
+						type: 'frame-missing',
+						camNo,
+						filename: path.basename(row.l_location),
+						consecutiveErrors: missing,
+						message: 'Frame files missing from disk',
+					})
+				);
+			}
+			return;
+		}
+		if (session.ws.readyState !== 1) {
+			session.active = false;
+			return false;
+		}
+		if (!flow.admit(camNo)) return false;
+
+		const { t_year, t_mon, t_mday, t_hour, t_min, t_sec, t_mill } = row;
+		const timestamp = new Date(t_year, t_mon - 1, t_mday, t_hour, t_min, t_sec, t_mill).getTime();
+		const header = {
+			camNo,
+			timestamp,
+			type: 'playback',
+			group: sessionId,
+			tier: frame.proxy ? 'proxy' : flow.current.tier,
+			mime: frame.proxy ? 'image/jpeg' : 'image/bmp',
+		};
+		const payload = playbackPayload(header, flow.encode(frame.image));
+		session.ws.send(payload);
+		flow.sent(payload.length);
+		session.frameCount++;
+		if (frame.proxy) session.proxyShown.set(camNo, { header, location: row.l_location });
+		else session.proxyShown.delete(camNo);
+
+		if (!started.has(camNo)) {
+			started.add(camNo);
+			cameraMetrics(camNo).playbackTtff.observe((performance.now() - session.requestedAt) / 1000);
+		}
+	};
+
+	const readFrame = async (row) => {
+		const readStart = performance.now();
+		const proxy = session.speed >= PROXY_MIN_SPEED && (await proxies.get(row.l_location));
+		const image = proxy || (await readPlaybackFrame(row.l_location));
+		cameraMetrics(row.camNo).playbackRead.observe((performance.now() - readStart) / 1000);
+		return { image, proxy: Boolean(proxy) };
+	};
+
+	try {
+		const result = await runGroupPlayback(session, scans, {
+			readFrame,
+			send,
+			onPause: () => refreshPausedFrames(session),
+			readAhead: PLAYBACK_GROUP_READ_AHEAD,
+			allowReadAhead: (queued) => shedder.allowReadAhead(queued),
+		});
+
+		if (result.empty) {
+			log(`[PLAYBACK] ${sessionId}: No frames found for specified time`, 'WARN');
+			if (session.ws.readyState === 1) {
+				session.ws.send(
+					JSON.stringify({
+						type: 'playback-no-data',
+						camNo: cameras[0],
+						cameras,
+						message: 'No frames found for the specified time period',
+					})
+				);
+			}
+		} else if (session.active && session.ws.readyState === 1) {
+			session.ws.send(JSON.stringify({ type: 'playback-complete', cameras, totalFrames: session.frameCount }));
+		}
+		log(`[PLAYBACK] ${sessionId}: ${result.sent} frames sent, ${result.dropped} dropped to keep cameras in sync`);
+	} catch (err) {
+		log(`[PLAYBACK] ${sessionId}: DB error - ${err.message}`, 'ERROR');
+		if (session.ws.readyState === 1) {
+			session.ws.send(JSON.stringify({ type: 'error', message: 'Playback failed.' }));
+		}
+	} finally {
+		if (playbackSessions.get(sessionId) === session) playbackSessions.delete(sessionId);
+		session.active = false;
+	}
+}
+
+// Held playback cursors across all sessions (bounded by PLAYBACK_MAX_CURSORS)
+let openPlaybackCursors = 0;
+
 // Start Playback Session
 async function startPlaybackSession(camNo) {
 	const session = playbackSessions.get(camNo);
 	if (!session || session.workerRunning) return;
 
 	session.workerRunning = true;
+	session.flow = new PlaybackFlow(session.ws, { windowBytes: PLAYBACK_SEND_WINDOW_BYTES, decisions: mPlaybackFlow });
+	const camMetrics = cameraMetrics(camNo);
 
 	let lastRowKey = null;
+	let lastTimestamp = null;
 	let fetching = false;
 	let finished = false;
 	let totalRowsFetched = 0;
 
+	const endOfFrames = () => {
+		finished = true;
+		if (totalRowsFetched > 0) {
+			log(`[PLAYBACK] ${camNo}: No more frames (total fetched: ${totalRowsFetched})`);
+			return;
+		}
+		log(`[PLAYBACK] ${camNo}: No frames found for specified time`, 'WARN');
+		if (session.ws.readyState === 1) {
+			session.ws.send(
+				JSON.stringify({
+					type: 'playback-no-data',
+					camNo,
+					message: 'No frames found for the specified time period',
+				})
+			);
+		}
+	};
+
+	const queueRow = (r) => {
+		const timestamp = new Date(r.t_year, r.t_mon - 1, r.t_mday, r.t_hour, r.t_min, r.t_sec, r.t_mill).getTime();
+		session.fileQueue.push({ filePath: path.resolve(r.l_location), timestamp });
+		lastRowKey = r;
+		lastTimestamp = timestamp;
+	};
+
+	// Stream rows from a held cursor straight into the file queue, pausing the
+	// socket while the queue is full. The cursor is closed on pause/stop and
+	// re-planned every PLAYBACK_CURSOR_WINDOW rows.
+	const openCursor = (query, params) => {
+		let windowRows = 0;
+		const openedAt = Date.now();
+		openPlaybackCursors++;
+
+		const cursor = new QueryCursor(db.reader, totalRowsFetched === 0 ? 'interactive' : 'prefetch', query, params, {
+			onRow: (r) => {
+				windowRows++;
+				totalRowsFetched++;
+				queueRow(r);
+				if (session.fileQueue.length >= PLAYBACK_QUEUE_HIGH) cursor.pause();
+			},
+			onClose: (err, completed) => {
+				openPlaybackCursors--;
+				if (session.cursor === cursor) session.cursor = null;
+
+				if (err) {
+					log(`[PLAYBACK] ${camNo}: DB cursor error - ${err.message}`, 'ERROR');
+					finished = true;
+					return;
+				}
+				log(`[PLAYBACK] ${camNo}: Cursor streamed ${windowRows} rows in ${Date.now() - openedAt}ms`);
+
+				// Index exhausted: only the recent-frame ring can take playback further
+				if (completed && windowRows < PLAYBACK_CURSOR_WINDOW) {
+					const from = lastTimestamp !== null ? lastTimestamp : session.startTime.getTime();
+					if (!recentFrames.covers(camNo, from)) endOfFrames();
+				}
+			},
+		});
+
+		session.cursor = cursor;
+		cursor.open();
+	};
+
 	// Fetch Next Batch
 	const fetchNextBatch = async () => {
 		if (!session.active || fetching || finished) return;
 		fetching = true;
 
-		let conn;
 		const queryStart = Date.now();
 
 		try {
-			conn = await pool.getConnection();
+			// Serve from the recent-frame ring while it still reaches back to the cursor;
+			// it also holds frames whose index rows have not been flushed yet
+			const recent = lastRowKey
+				? recentFrames.framesAfter(camNo, lastTimestamp, false, PLAYBACK_BATCH_SIZE)
+				: recentFrames.framesAfter(camNo, session.startTime.getTime(), true, PLAYBACK_BATCH_SIZE);
+
+			if (recent) {
+				if (session.cursor) {
+					// Its connection comes back once the skip drains; don't resume it meanwhile
+					session.cursor.close();
+					session.cursor = null;
+				}
+				if (recent.length === 0) {
+					log(`[PLAYBACK] ${camNo}: Reached live edge`);
+					endOfFrames();
+					return;
+				}
+
+				totalRowsFetched += recent.length;
+				log(`[PLAYBACK] ${camNo}: ${recent.length} frames from memory (total: ${totalRowsFetched})`);
+
+				for (const entry of recent) {
+					session.fileQueue.push({
+						filePath: path.join(BMP_FOLDER, entry.filename),
+						timestamp: entry.timestamp,
+						recent: entry,
+					});
+				}
+
+				lastTimestamp = recent[recent.length - 1].timestamp;
+				lastRowKey = rowKeyFromMs(lastTimestamp);
+				return;
+			}
+
+			// A held cursor is already feeding the queue; just release its backpressure
+			if (session.cursor) {
+				session.cursor.resume();
+				return;
+			}
+
+			const useCursor = openPlaybackCursors < PLAYBACK_MAX_CURSORS && !session.paused;
+			const limit = useCursor ? PLAYBACK_CURSOR_WINDOW : PLAYBACK_BATCH_SIZE;
 
 			let query;
 			let params;
@@ -835,7 +2104,7 @@ async function startPlaybackSession(camNo) {
 					s.getMinutes(),
 					s.getSeconds(),
 					s.getMilliseconds(),
-					PLAYBACK_BATCH_SIZE,
+					limit,
 				];
 			} else {
 				// CONTINUATION QUERY: Start AFTER last row (including milliseconds)
@@ -886,34 +2155,23 @@ async function startPlaybackSession(camNo) {
 					lr.t_min,
 					lr.t_sec,
 					lr.t_mill,
-					PLAYBACK_BATCH_SIZE,
+					limit,
 				];
 			}
 
-			const rows = await conn.query(query, params);
+			if (useCursor) {
+				openCursor(query, params);
+				return;
+			}
+
+			// The first batch is what the viewer is waiting on; later ones are read-ahead
+			const rows = await db.reader.withConnection(lastRowKey ? 'prefetch' : 'interactive', (conn) =>
+				conn.query(query, params)
+			);
 			const queryTime = Date.now() - queryStart;
 
 			if (rows.length === 0) {
-				finished = true;
-
-				// Check if this is the FIRST batch (no frames found at all)
-				if (totalRowsFetched === 0) {
-					log(`[PLAYBACK] ${camNo}: No frames found for specified time`, 'WARN');
-
-					// Notify frontend
-					if (session.ws.readyState === 1) {
-						session.ws.send(
-							JSON.stringify({
-								type: 'playback-no-data',
-								camNo,
-								message: 'No frames found for the specified time period',
-							})
-						);
-					}
-				} else {
-					log(`[PLAYBACK] ${camNo}: No more frames (total fetched: ${totalRowsFetched})`);
-				}
-
+				endOfFrames();
 				return;
 			}
 
@@ -922,28 +2180,12 @@ async function startPlaybackSession(camNo) {
 				`[PLAYBACK] ${camNo}: Fetched ${rows.length} rows in ${queryTime}ms (total: ${totalRowsFetched})`
 			);
 
-			lastRowKey = rows[rows.length - 1];
-
 			// Add to file queue
-			for (const r of rows) {
-				session.fileQueue.push({
-					filePath: path.resolve(r.l_location),
-					timestamp: new Date(
-						r.t_year,
-						r.t_mon - 1,
-						r.t_mday,
-						r.t_hour,
-						r.t_min,
-						r.t_sec,
-						r.t_mill
-					).getTime(),
-				});
-			}
+			for (const r of rows) queueRow(r);
 		} catch (err) {
 			log(`[PLAYBACK] ${camNo}: DB error - ${err.message}`, 'ERROR');
 			finished = true;
 		} finally {
-			if (conn) conn.end();
 			fetching = false;
 		}
 	};
@@ -956,7 +2198,12 @@ async function startPlaybackSession(camNo) {
 
 		while (session.active) {
 			// Trigger fetch if queue is low and more data available
-			if (session.fileQueue.length <= PLAYBACK_QUEUE_LOW && !fetching && !finished) {
+			if (
+				session.fileQueue.length <= PLAYBACK_QUEUE_LOW &&
+				!fetching &&
+				!finished &&
+				shedder.allowReadAhead(session.fileQueue.length)
+			) {
 				fetchNextBatch();
 			}
 
@@ -986,20 +2233,37 @@ async function startPlaybackSession(camNo) {
 
 			// Check for pause
 			if (session.paused) {
+				if (session.proxyShown.size > 0) await refreshPausedFrames(session);
 				await new Promise((r) => setTimeout(r, 100));
 				continue;
 			}
 
 			const frame = session.fileQueue.shift();
 
+			// Client behind: hold this frame back but keep its time slot, so playback speed is unchanged
+			if (!session.flow.admit(camNo)) {
+				await new Promise((r) => setTimeout(r, PLAYBACK_DELAY_MS / session.speed));
+				continue;
+			}
+
 			try {
 				// Read BMP file
 				const readStart = Date.now();
 				let imageBuffer;
 				let actualPath = frame.filePath;
+				const proxy = session.speed >= PROXY_MIN_SPEED && (await proxies.get(frame.filePath));
 
 				try {
-					imageBuffer = await fs.readFile(frame.filePath);
+					if (proxy) {
+						imageBuffer = proxy;
+						actualPath = null;
+					} else if (frame.recent) {
+						const { format, imageBuffer: pixels } = frame.recent;
+						imageBuffer = format ? Buffer.concat(bmpParts(format, pixels)) : pixels;
+						actualPath = null;
+					} else {
+						imageBuffer = await fs.readFile(frame.filePath);
+					}
 				} catch (err) {
 					if (frame.filePath.includes('generated')) {
 						const fallbackPath = frame.filePath.replace(/[/\\]generated[/\\]/, '/');
@@ -1015,27 +2279,37 @@ async function startPlaybackSession(camNo) {
 					}
 				}
 
+				// Raw-transport frames get their BMP header synthesized on the way out
+				if (actualPath && isRawFile(actualPath)) imageBuffer = frameFileToBmp(imageBuffer);
+				imageBuffer = session.flow.encode(imageBuffer);
+
 				const readTime = Date.now() - readStart;
+				camMetrics.playbackRead.observe(readTime / 1000);
 
 				readTimes.push(readTime);
 				if (readTimes.length > 20) readTimes.shift();
 
 				// Create binary payload
-				const header = JSON.stringify({
+				const header = {
 					camNo,
 					timestamp: frame.timestamp,
 					type: 'playback',
-				});
-				const headerBuf = Buffer.from(header);
-				const headerLen = Buffer.alloc(4);
-				headerLen.writeUInt32BE(headerBuf.length, 0);
-				const payload = Buffer.concat([headerLen, headerBuf, imageBuffer]);
+					tier: proxy ? 'proxy' : session.flow.current.tier,
+					mime: proxy ? 'image/jpeg' : 'image/bmp',
+				};
+				const payload = playbackPayload(header, imageBuffer);
 
 				// Send frame
 				if (session.ws.readyState === 1) {
 					session.ws.send(payload);
+					session.flow.sent(payload.length);
 					session.frameCount++;
+					if (proxy) session.proxyShown.set(camNo, { header, location: frame.filePath });
+					else session.proxyShown.delete(camNo);
 					consecutiveErrors = 0;
+					if (session.frameCount === 1) {
+						camMetrics.playbackTtff.observe((performance.now() - session.requestedAt) / 1000);
+					}
 				} else {
 					log(`[PLAYBACK] ${camNo}: WebSocket closed, stopping`, 'WARN');
 					session.active = false;
@@ -1105,6 +2379,7 @@ async function startPlaybackSession(camNo) {
 		}
 
 		// Cleanup
+		if (session.cursor) session.cursor.close();
 		log(`[PLAYBACK] ${camNo}: Worker stopped (${session.frameCount} frames sent)`);
 		playbackSessions.delete(camNo);
 		session.workerRunning = false;
@@ -0,0 +1,199 @@
+// TCP ingest protocol (Camera -> Node, port 9000)
+//
+// On connect the server sends a 6-byte banner: 'SVPV' u8 minVersion u8 maxVersion.
+// Clients that read it may switch to v2; clients that never read it keep
+// sending v1, and both are accepted on the same port, frame by frame.
+//
+// v1: u32 BE metadata length | metadata JSON { camNo, timestamp, filename, size } | frame bytes
+//
+// v2: fixed 32-byte big-endian header | frame bytes
+//   0   u32  magic 'SVF2'
+//   4   u8   version (2)
+//   5   u8   codec (CODEC_*)
+//   6   u16  header length (32; larger values carry extension bytes before the frame)
+//   8   char camNo[8], NUL padded (senders reject longer names rather than cut them)
+//   16  u64  capture timestamp (epoch ms)
+//   24  u32  frame size
+//   28  u32  CRC-32 of header bytes 0..27 and any extension bytes
+//   raw codecs (CODEC_BGR24, CODEC_YUYV) append an 8-byte extension:
+//   32  u16  width
+//   34  u16  height
+//   36  u32  stride (bytes per row)
+//
+// v1 raw frames describe themselves with format/width/height/stride keys in the JSON.
+//
+// 'SVF2' read as a v1 metadata length would be ~1.4 GB, so the two never collide.
+
+const { CODEC_BMP, isRawCodec, codecFromName, checkPixelFormat } = require('./frameFormat');
+
+const PROTOCOL_MIN_VERSION = 1;
+const PROTOCOL_MAX_VERSION = 2;
+
+const BANNER_MAGIC = 0x53565056; // 'SVPV'
+const FRAME_MAGIC_V2 = 0x53564632; // 'SVF2'
+const V2_HEADER_SIZE = 32;
+const MAX_FRAME_SIZE = 64 * 1024 * 1024;
+
+const RAW_EXTENSION_SIZE = 8;
+
+const CRC_TABLE = new Int32Array(256);
+for (let n = 0; n < 256; n++) {
+	let c = n;
+	for (let k = 0; k < 8; k++) c = c & 1 ? 0xedb88320 ^ (c >>> 1) : c >>> 1;
+	CRC_TABLE[n] = c;
+}
+
+// Standard CRC-32 (same as zlib.crc32), chainable through `crc`
+function crc32(buf, start = 0, end = buf.length, crc = 0) {
+	crc = ~crc;
+	for (let i = start; i < end; i++) crc = CRC_TABLE[(crc ^ buf[i]) & 0xff] ^ (crc >>> 8);
+	return ~crc >>> 0;
+}
+
+function makeBanner() {
+	const banner = Buffer.alloc(6);
+	banner.writeUInt32BE(BANNER_MAGIC, 0);
+	banner.writeUInt8(PROTOCOL_MIN_VERSION, 4);
+	banner.writeUInt8(PROTOCOL_MAX_VERSION, 5);
+	return banner;
+}
+
+function readCamNo(buf, offset, length) {
+	let end = offset;
+	while (end < offset + length && buf[end] !== 0) end++;
+	return buf.toString('latin1', offset, end);
+}
+
+// Incremental frame parser for one camera connection.
+// onFrame({ version, camNo, timestamp, filename, format, imageBuffer, receivedAt })
+//   filename is null for v2; format is null for BMP or { codec, width, height, stride } for raw pixels
+//   receivedAt is the epoch ms of the push() that completed the frame header
+// push() throws on a corrupt stream; the caller should drop the connection.
+class IngestParser {
+	constructor(onFrame) {
+		this.onFrame = onFrame;
+		this.chunks = [];
+		this.length = 0;
+		this.needed = 0; // bytes required before parsing is worth attempting again
+		this.buffer = null;
+		this.header = null;
+	}
+
+	push(data) {
+		// Gather chunks until a whole frame body is present, then concatenate once
+		this.chunks.push(data);
+		this.length += data.length;
+		if (this.length < this.needed) return;
+
+		this.buffer = this.chunks.length === 1 ? this.chunks[0] : Buffer.concat(this.chunks, this.length);
+
+		while (true) {
+			if (!this.header && !this.readHeader()) break;
+
+			const { size } = this.header;
+			if (this.buffer.length < size) break;
+
+			const imageBuffer = this.buffer.subarray(0, size);
+			this.buffer = this.buffer.subarray(size);
+
+			const header = this.header;
+			this.header = null;
+			header.imageBuffer = imageBuffer;
+			this.onFrame(header);
+		}
+
+		this.chunks = this.buffer.length > 0 ? [this.buffer] : [];
+		this.length = this.buffer.length;
+		this.needed = this.header ? this.header.size : 0;
+		this.buffer = null;
+	}
+
+	readHeader() {
+		const buf = this.buffer;
+		if (buf.length < 4) return false;
+
+		const lead = buf.readUInt32BE(0);
+
+		if (lead === FRAME_MAGIC_V2) {
+			if (buf.length < 8) return false;
+			const version = buf.readUInt8(4);
+			if (version !== 2) throw new Error(`Unsupported frame version ${version}`);
+			const headerLength = buf.readUInt16BE(6);
+			if (headerLength < V2_HEADER_SIZE) throw new Error(`Bad v2 header length ${headerLength}`);
+			if (buf.length < headerLength) return false;
+
+			let crc = crc32(buf, 0, 28);
+			if (headerLength > V2_HEADER_SIZE) crc = crc32(buf, V2_HEADER_SIZE, headerLength, crc);
+			if (crc !== buf.readUInt32BE(28)) throw new Error('v2 header CRC mismatch');
+
+			const size = buf.readUInt32BE(24);
+			if (size > MAX_FRAME_SIZE) throw new Error(`Frame too large (${size} bytes)`);
+
+			const codec = buf.readUInt8(5);
+			let format = null;
+			if (codec !== CODEC_BMP) {
+				if (!isRawCodec(codec) || headerLength < V2_HEADER_SIZE + RAW_EXTENSION_SIZE) {
+					throw new Error(`Unsupported v2 codec ${codec}`);
+				}
+				format = {
+					codec,
+					width: buf.readUInt16BE(32),
+					height: buf.readUInt16BE(34),
+					stride: buf.readUInt32BE(36),
+				};
+				const problem = checkPixelFormat(format, size);
+				if (problem) throw new Error(problem);
+			}
+
+			this.header = {
+				version,
+				camNo: readCamNo(buf, 8, 8),
+				timestamp: Number(buf.readBigUInt64BE(16)),
+				filename: null,
+				format,
+				size,
+				receivedAt: Date.now(),
+			};
+			this.buffer = buf.subarray(headerLength);
+			return true;
+		}
+
+		// v1: JSON metadata
+		if (lead > MAX_FRAME_SIZE) throw new Error(`Bad metadata length ${lead}`);
+		if (buf.length < 4 + lead) return false;
+
+		const metadata = JSON.parse(buf.toString('utf-8', 4, 4 + lead));
+		if (!Number.isInteger(metadata.size) || metadata.size < 0 || metadata.size > MAX_FRAME_SIZE) {
+			throw new Error(`Bad v1 frame size ${metadata.size}`);
+		}
+		let format = null;
+		if (metadata.format && metadata.format !== 'bmp') {
+			format = {
+				codec: codecFromName(metadata.format),
+				width: metadata.width,
+				height: metadata.height,
+				stride: metadata.stride,
+			};
+			const problem = checkPixelFormat(format, metadata.size);
+			if (problem) throw new Error(problem);
+		}
+
+		this.header = {
+			version: 1,
+			camNo: metadata.camNo,
+			timestamp: metadata.timestamp,
+			filename: metadata.filename,
+			format,
+			size: metadata.size,
+			receivedAt: Date.now(),
+		};
+		this.buffer = buf.subarray(4 + lead);
+		return true;
+	}
+}
+
+module.exports = {
+	IngestParser,
+	makeBanner,
+	crc32,
+};
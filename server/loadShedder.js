@@ -0,0 +1,147 @@
+// Graduated load shedding driven by event-loop delay
+//
+// Every `intervalMs` the p99 event-loop delay of the last interval is
+// compared against `thresholdsMs` (one per level). The level rises as soon
+// as a threshold is crossed and falls one step at a time once the delay has
+// stayed below `recoverRatio` of the current level's threshold for
+// `cooldownIntervals` in a row. Levels are cumulative:
+//   1 LIVE_THROTTLE     live frames to unfocused viewers are decimated
+//   2 DEFER_BACKGROUND  deferrable work (thumbnails, transcoding) waits
+//   3 PAUSE_READAHEAD   playback stops prefetching beyond the next frame
+//   4 REJECT_POSTS      POST /api/frames answers 429
+
+const { monitorEventLoopDelay } = require('perf_hooks');
+const { log } = require('./log');
+
+const LEVEL_NAMES = ['NORMAL', 'LIVE_THROTTLE', 'DEFER_BACKGROUND', 'PAUSE_READAHEAD', 'REJECT_POSTS'];
+
+class LoadShedder {
+	constructor({
+		registry,
+		thresholdsMs = [40, 80, 150, 300],
+		intervalMs = 500,
+		recoverRatio = 0.6,
+		cooldownIntervals = 4,
+		liveDivisor = 3,
+	}) {
+		this.thresholdsMs = thresholdsMs;
+		this.intervalMs = intervalMs;
+		this.recoverRatio = recoverRatio;
+		this.cooldownIntervals = cooldownIntervals;
+		this.liveDivisor = liveDivisor;
+
+		this.level = 0;
+		this.calm = 0;
+		this.lastDelayMs = 0;
+		this.deferred = [];
+		this.timer = null;
+		this.monitor = monitorEventLoopDelay({ resolution: 10 });
+
+		registry.gauge('surveillance_shed_level', 'Current load-shedding level (0 = normal)', [], (g) =>
+			g.labels().set(this.level)
+		);
+		registry.gauge(
+			'surveillance_shed_loop_delay_seconds',
+			'p99 event-loop delay over the last shedding interval',
+			[],
+			(g) => g.labels().set(this.lastDelayMs / 1000)
+		);
+		registry.gauge('surveillance_shed_deferred_tasks', 'Deferrable tasks waiting for load to drop', [], (g) =>
+			g.labels().set(this.deferred.length)
+		);
+		const transitions = registry.counter('surveillance_shed_transitions_total', 'Shedding level changes', [
+			'level',
+		]);
+		this.transitions = LEVEL_NAMES.map((name) => transitions.labels(name));
+		const decisions = registry.counter('surveillance_shed_decisions_total', 'Work shed or deferred', ['action']);
+		this.decisions = {
+			liveFrameSkipped: decisions.labels('live_frame_skipped'),
+			taskDeferred: decisions.labels('task_deferred'),
+			readaheadPaused: decisions.labels('readahead_paused'),
+			postRejected: decisions.labels('post_rejected'),
+		};
+	}
+
+	start() {
+		this.monitor.enable();
+		this.timer = setInterval(() => this.evaluate(), this.intervalMs);
+		this.timer.unref();
+	}
+
+	stop() {
+		clearInterval(this.timer);
+		this.monitor.disable();
+	}
+
+	evaluate() {
+		const delayMs = this.monitor.percentile(99) / 1e6;
+		this.monitor.reset();
+		this.lastDelayMs = delayMs;
+
+		let target = 0;
+		while (target < this.thresholdsMs.length && delayMs >= this.thresholdsMs[target]) target++;
+
+		if (target > this.level) {
+			this.calm = 0;
+			this.setLevel(target, delayMs);
+		} else if (this.level > 0 && delayMs < this.thresholdsMs[this.level - 1] * this.recoverRatio) {
+			if (++this.calm >= this.cooldownIntervals) {
+				this.calm = 0;
+				this.setLevel(this.level - 1, delayMs);
+			}
+		} else {
+			this.calm = 0;
+		}
+	}
+
+	setLevel(level, delayMs) {
+		const previous = this.level;
+		this.level = level;
+		this.transitions[level].inc();
+		log(
+			`[SHED] Level ${previous} -> ${level} (${LEVEL_NAMES[level]}) | Loop delay p99: ${delayMs.toFixed(0)}ms`,
+			level > previous ? 'WARN' : 'INFO'
+		);
+		if (level < 2) this.runDeferred();
+	}
+
+	// Level 1: should this live frame be skipped for a viewer? `viewer` keeps a per-client counter.
+	skipLiveFrame(viewer) {
+		if (this.level < 1 || viewer.focused !== false) return false;
+		viewer.shedCounter = (viewer.shedCounter || 0) + 1;
+		if (viewer.shedCounter % this.liveDivisor === 0) return false;
+		this.decisions.liveFrameSkipped.inc();
+		return true;
+	}
+
+	// Level 2: run `task` now, or once load drops below DEFER_BACKGROUND; resolves with its result
+	deferrable(task) {
+		if (this.level < 2) return new Promise((resolve) => resolve(task()));
+		this.decisions.taskDeferred.inc();
+		return new Promise((resolve, reject) => this.deferred.push({ task, resolve, reject }));
+	}
+
+	runDeferred() {
+		const tasks = this.deferred;
+		this.deferred = [];
+		for (const { task, resolve, reject } of tasks) {
+			Promise.resolve().then(task).then(resolve, reject);
+		}
+	}
+
+	// Level 3: may playback prefetch more rows while `queued` frames are still buffered?
+	allowReadAhead(queued) {
+		if (this.level < 3 || queued === 0) return true;
+		this.decisions.readaheadPaused.inc();
+		return false;
+	}
+
+	// Level 4: should this POST be turned away?
+	rejectPost() {
+		if (this.level < 4) return false;
+		this.decisions.postRejected.inc();
+		return true;
+	}
+}
+
+module.exports = { LoadShedder, LEVEL_NAMES };
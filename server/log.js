@@ -0,0 +1,7 @@
+// Logging utility
+function log(message, level = 'INFO') {
+	const timestamp = new Date().toTimeString().substring(0, 12);
+	console.log(`[${timestamp}] [${level}] ${message}`);
+}
+
+module.exports = { log };
@@ -0,0 +1,216 @@
+// Prometheus text-format metrics (exposition format 0.0.4)
+//
+// Metrics are families of labelled children. Resolving a child with
+// labels(...) builds a key string, so callers resolve children once (per
+// camera, per transport) and keep them; inc/set/observe on a child only
+// touch preallocated numbers and typed arrays, so updates on the frame path
+// allocate nothing. Gauges whose value lives elsewhere (queue lengths,
+// socket buffers) take a collect callback that runs at scrape time instead.
+
+const DEFAULT_BUCKETS = [0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10];
+
+function escapeLabel(value) {
+	return String(value).replace(/\\/g, '\\\\').replace(/\n/g, '\\n').replace(/"/g, '\\"');
+}
+
+function formatValue(v) {
+	if (v === Infinity) return '+Inf';
+	if (v === -Infinity) return '-Inf';
+	return String(v);
+}
+
+class CounterChild {
+	constructor(labelText) {
+		this.labelText = labelText;
+		this.value = 0;
+	}
+
+	inc(n = 1) {
+		this.value += n;
+	}
+}
+
+class GaugeChild {
+	constructor(labelText) {
+		this.labelText = labelText;
+		this.value = 0;
+	}
+
+	set(v) {
+		this.value = v;
+	}
+
+	inc(n = 1) {
+		this.value += n;
+	}
+
+	dec(n = 1) {
+		this.value -= n;
+	}
+}
+
+class HistogramChild {
+	constructor(labelText, buckets) {
+		this.labelText = labelText;
+		this.buckets = buckets;
+		this.counts = new Float64Array(buckets.length + 1); // last slot is +Inf
+		this.sum = 0;
+		this.count = 0;
+	}
+
+	observe(v) {
+		const buckets = this.buckets;
+		let i = 0;
+		while (i < buckets.length && v > buckets[i]) i++;
+		this.counts[i]++;
+		this.sum += v;
+		this.count++;
+	}
+}
+
+class Metric {
+	constructor(type, name, help, labelNames) {
+		this.type = type;
+		this.name = name;
+		this.help = help;
+		this.labelNames = labelNames;
+		this.children = new Map();
+	}
+
+	// Not for the hot path: resolve once and keep the child
+	labels(...values) {
+		const key = values.join('\u0000');
+		let child = this.children.get(key);
+		if (!child) {
+			const labelText = this.labelNames.map((n, i) => `${n}="${escapeLabel(values[i])}"`).join(',');
+			child = this.makeChild(labelText);
+			this.children.set(key, child);
+		}
+		return child;
+	}
+
+	remove(...values) {
+		this.children.delete(values.join('\u0000'));
+	}
+
+	header() {
+		return `# HELP ${this.name} ${this.help}\n# TYPE ${this.name} ${this.type}\n`;
+	}
+
+	sample(suffix, labelText, value) {
+		return `${this.name}${suffix}${labelText ? `{${labelText}}` : ''} ${formatValue(value)}\n`;
+	}
+}
+
+class Counter extends Metric {
+	constructor(name, help, labelNames) {
+		super('counter', name, help, labelNames);
+	}
+
+	makeChild(labelText) {
+		return new CounterChild(labelText);
+	}
+
+	render() {
+		let out = this.header();
+		for (const c of this.children.values()) out += this.sample('', c.labelText, c.value);
+		return out;
+	}
+}
+
+class Gauge extends Metric {
+	constructor(name, help, labelNames, collect) {
+		super('gauge', name, help, labelNames);
+		this.collect = collect || null;
+	}
+
+	makeChild(labelText) {
+		return new GaugeChild(labelText);
+	}
+
+	render() {
+		if (this.collect) this.collect(this);
+		let out = this.header();
+		for (const c of this.children.values()) out += this.sample('', c.labelText, c.value);
+		return out;
+	}
+}
+
+class Histogram extends Metric {
+	constructor(name, help, labelNames, buckets) {
+		super('histogram', name, help, labelNames);
+		this.buckets = buckets || DEFAULT_BUCKETS;
+	}
+
+	makeChild(labelText) {
+		return new HistogramChild(labelText, this.buckets);
+	}
+
+	render() {
+		let out = this.header();
+		for (const c of this.children.values()) {
+			const sep = c.labelText ? ',' : '';
+			let cumulative = 0;
+			for (let i = 0; i <= this.buckets.length; i++) {
+				cumulative += c.counts[i];
+				const le = i < this.buckets.length ? this.buckets[i] : Infinity;
+				out += this.sample('_bucket', `${c.labelText}${sep}le="${formatValue(le)}"`, cumulative);
+			}
+			out += this.sample('_sum', c.labelText, c.sum);
+			out += this.sample('_count', c.labelText, c.count);
+		}
+		return out;
+	}
+}
+
+class Registry {
+	constructor() {
+		this.metrics = [];
+	}
+
+	counter(name, help, labelNames = []) {
+		return this.register(new Counter(name, help, labelNames));
+	}
+
+	gauge(name, help, labelNames = [], collect = null) {
+		return this.register(new Gauge(name, help, labelNames, collect));
+	}
+
+	histogram(name, help, labelNames = [], buckets = DEFAULT_BUCKETS) {
+		return this.register(new Histogram(name, help, labelNames, buckets));
+	}
+
+	register(metric) {
+		this.metrics.push(metric);
+		return metric;
+	}
+
+	render() {
+		return this.metrics.map((m) => m.render()).join('');
+	}
+}
+
+Registry.CONTENT_TYPE = 'text/plain; version=0.0.4; charset=utf-8';
+
+// Label values for per-camera series. camNo arrives from clients, so every
+// label value is a series that is never removed: names that don't look like a
+// camera, and any camera past the first `max` seen, share the `other` label.
+class CameraLabels {
+	constructor(max) {
+		this.max = max;
+		this.seen = new Set();
+	}
+
+	of(camNo) {
+		const name = String(camNo);
+		if (this.seen.has(name)) return name;
+		if (this.seen.size >= this.max || !CameraLabels.NAME_RE.test(name)) return CameraLabels.OTHER;
+		this.seen.add(name);
+		return name;
+	}
+}
+
+CameraLabels.NAME_RE = /^[A-Za-z0-9_-]{1,32}$/;
+CameraLabels.OTHER = 'other';
+
+module.exports = { Registry, CameraLabels, DEFAULT_BUCKETS };
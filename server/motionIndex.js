@@ -0,0 +1,233 @@
+// Per-frame motion scores (tb_motion) and motion queries
+//
+// After a frame is stored, an image worker reduces it to a grid of mean luma
+// (imageWorker.js op lumaGrid). Each camera's grids are compared in ingest
+// order with the camera's previous analysed frame. The score is the share of
+// cells whose luma moved by more than MOTION_NOISE levels, in permille, so
+// 1000 means the whole picture changed. A camera's first frame has no score.
+//
+// Scores are batched into tb_motion keyed (camNo, ts), with ts in wall-clock
+// ms like rollups.js. Seeks and interval queries read only that narrow table,
+// never tb_index or frame files. Analysis is best-effort like proxies: jobs
+// are deferrable under load and capped at `queueMax`. A dropped frame has no
+// score, and the next frame is compared with the last one analysed.
+
+const { log } = require('./log');
+const { wallClockMs } = require('./rollups');
+
+const MOTION_GRID_COLS = 32;
+const MOTION_GRID_ROWS = 24;
+const MOTION_NOISE = 12; // luma levels a cell may drift without counting as changed
+const MOTION_DEFAULT_MIN = 2; // percent of cells
+const MOTION_DEFAULT_GAP_MS = 2000;
+const MOTION_MAX_INTERVALS = 1000;
+
+const CREATE_SQL = `
+	CREATE TABLE IF NOT EXISTS tb_motion (
+		camNo VARCHAR(32) NOT NULL,
+		ts BIGINT NOT NULL,
+		score SMALLINT UNSIGNED NOT NULL,
+		PRIMARY KEY (camNo, ts)
+	)
+`;
+
+// Wall-clock ms back to epoch ms (the local time it names)
+function fromWallClockMs(ms) {
+	const d = new Date(ms);
+	return new Date(
+		d.getUTCFullYear(),
+		d.getUTCMonth(),
+		d.getUTCDate(),
+		d.getUTCHours(),
+		d.getUTCMinutes(),
+		d.getUTCSeconds(),
+		d.getUTCMilliseconds()
+	).getTime();
+}
+
+// Two luma grids -> { score (permille), changed (1 per moved cell) }
+function compareGrids(prev, next) {
+	const changed = new Uint8Array(next.length);
+	let moved = 0;
+	for (let i = 0; i < next.length; i++) {
+		if (Math.abs(next[i] - prev[i]) > MOTION_NOISE) {
+			changed[i] = 1;
+			moved++;
+		}
+	}
+	return { score: Math.round((moved * 1000) / next.length), changed };
+}
+
+class MotionIndex {
+	// writer: db.analysis, not the batcher pool; onDiff({ camNo, timestamp, score, changed }) sees every scored frame,
+	// onGrid({ camNo, timestamp, grid }) every analysed one (including a camera's first)
+	constructor({ pool, shedder, writer, registry, onDiff, onGrid, queueMax = 256, batchSize = 200, flushMs = 2000 }) {
+		this.pool = pool;
+		this.shedder = shedder;
+		this.writer = writer;
+		this.onDiff = onDiff;
+		this.onGrid = onGrid;
+		this.queueMax = queueMax;
+		this.batchSize = batchSize;
+		this.flushMs = flushMs;
+		this.pending = 0;
+		this.failures = 0;
+		this.cameras = new Map(); // camNo -> { chain, grid }
+		this.rows = []; // [camNo, ts, score] waiting for the next flush
+		this.enabled = false;
+		this.flushing = false;
+		this.timer = null;
+
+		const frames = registry.counter('surveillance_motion_frames_total', 'Motion analysis by outcome', ['result']);
+		this.results = {
+			scored: frames.labels('scored'),
+			dropped: frames.labels('dropped'),
+			failed: frames.labels('failed'),
+		};
+	}
+
+	async init() {
+		await this.writer.withConnection((conn) => conn.query(CREATE_SQL));
+		this.enabled = true;
+		this.timer = setInterval(() => this.flush(), this.flushMs);
+		this.timer.unref();
+	}
+
+	// Queue a stored frame; scores come out in submission order per camera
+	submit(camNo, timestamp, filePath) {
+		if (!this.enabled || this.pool.failure) return;
+		if (this.pending >= this.queueMax) {
+			this.results.dropped.inc();
+			return;
+		}
+
+		let cam = this.cameras.get(camNo);
+		if (!cam) {
+			cam = { chain: Promise.resolve(), grid: null };
+			this.cameras.set(camNo, cam);
+		}
+
+		this.pending++;
+		const task = { op: 'lumaGrid', filePath, cols: MOTION_GRID_COLS, rows: MOTION_GRID_ROWS };
+		const grid = this.shedder.deferrable(() => this.pool.run(task));
+		grid.catch(() => {}); // handled in order below
+		cam.chain = cam.chain
+			.then(() => grid)
+			.then((next) => {
+				const prev = cam.grid;
+				cam.grid = next;
+				if (this.onGrid) this.onGrid({ camNo, timestamp, grid: next });
+				if (!prev) return;
+				const { score, changed } = compareGrids(prev, next);
+				this.results.scored.inc();
+				this.rows.push([camNo, wallClockMs(timestamp), score]);
+				if (this.rows.length >= this.batchSize) this.flush();
+				if (this.onDiff) this.onDiff({ camNo, timestamp, score, changed });
+			})
+			.catch((err) => {
+				this.results.failed.inc();
+				if (this.failures++ % 100 === 0) {
+					log(`[MOTION] ${camNo}: ${err.message} (${this.failures} failed)`, 'WARN');
+				}
+			})
+			.finally(() => this.pending--);
+	}
+
+	async flush() {
+		if (this.rows.length === 0 || this.flushing) return;
+		this.flushing = true;
+		const batch = this.rows.splice(0, this.batchSize);
+		try {
+			await this.writer.withConnection((conn) =>
+				conn.query(
+					`INSERT INTO tb_motion (camNo, ts, score) VALUES ${batch.map(() => '(?, ?, ?)').join(', ')}
+					ON DUPLICATE KEY UPDATE score = GREATEST(score, VALUES(score))`,
+					batch.flat()
+				)
+			);
+		} catch (err) {
+			log(`[MOTION] Insert error: ${err.message}`, 'ERROR');
+			// Retry with the next flush; beyond a few batches the oldest scores are given up
+			this.rows = batch.concat(this.rows).slice(-this.batchSize * 50);
+		} finally {
+			this.flushing = false;
+		}
+	}
+
+	stop() {
+		clearInterval(this.timer);
+		return this.flush();
+	}
+}
+
+// Shared options: camNo (required), min: percent of the picture changed (default 2)
+function motionParams(q) {
+	if (!q.camNo) return { error: 'camNo is required' };
+	const min = q.min !== undefined && q.min !== '' ? Number(q.min) : MOTION_DEFAULT_MIN;
+	if (!Number.isFinite(min) || min < 0 || min > 100) return { error: 'min must be 0-100 (percent)' };
+	return { camNo: String(q.camNo), minScore: Math.round(min * 10) };
+}
+
+// Next (dir=after) or previous (dir=before) scored frame at or above min, strictly past ts (epoch ms).
+// Returns { camNo, ts, dir, sql, params } or { error }
+function buildMotionSeekQuery(q) {
+	const p = motionParams(q);
+	if (p.error) return p;
+	const ts = Number(q.ts);
+	if (!q.ts || !Number.isFinite(ts)) return { error: 'ts (epoch ms) is required' };
+	const dir = q.dir ? String(q.dir) : 'after';
+	if (dir !== 'after' && dir !== 'before') return { error: 'dir must be after or before' };
+
+	return {
+		camNo: p.camNo,
+		ts,
+		dir,
+		sql: `SELECT ts, score FROM tb_motion WHERE camNo = ? AND ts ${dir === 'after' ? '>' : '<'} ? AND score >= ?
+			ORDER BY ts ${dir === 'after' ? 'ASC' : 'DESC'} LIMIT 1`,
+		params: [p.camNo, wallClockMs(new Date(ts)), p.minScore],
+	};
+}
+
+// Runs of frames at or above min, split where consecutive ones are more than `gap` ms apart.
+// start & end epoch ms. Rows: { start, end, peak, frames } (wall-clock ms). Returns { ..., sql, params } or { error }
+function buildMotionIntervalsQuery(q) {
+	const p = motionParams(q);
+	if (p.error) return p;
+	const start = Number(q.start);
+	const end = Number(q.end);
+	if (!q.start || !q.end || !(end > start)) return { error: 'start & end (epoch ms) are required' };
+	const gap = q.gap ? Number(q.gap) : MOTION_DEFAULT_GAP_MS;
+	if (!Number.isFinite(gap) || gap < 0) return { error: 'gap must be >= 0 (ms)' };
+
+	// Gaps and islands: a new interval starts wherever the previous frame is too far back
+	return {
+		camNo: p.camNo,
+		start,
+		end,
+		gap,
+		sql: `
+			SELECT MIN(ts) AS start, MAX(ts) AS end, MAX(score) AS peak, COUNT(*) AS frames
+			FROM (
+				SELECT ts, score, SUM(brk) OVER (ORDER BY ts) AS island
+				FROM (
+					SELECT ts, score, CASE WHEN ts - LAG(ts) OVER (ORDER BY ts) <= ? THEN 0 ELSE 1 END AS brk
+					FROM tb_motion
+					WHERE camNo = ? AND ts >= ? AND ts <= ? AND score >= ?
+				) marked
+			) grouped
+			GROUP BY island
+			ORDER BY start
+			LIMIT ${MOTION_MAX_INTERVALS}
+		`,
+		params: [gap, p.camNo, wallClockMs(new Date(start)), wallClockMs(new Date(end)), p.minScore],
+	};
+}
+
+module.exports = {
+	MotionIndex,
+	buildMotionSeekQuery,
+	buildMotionIntervalsQuery,
+	fromWallClockMs,
+	MOTION_GRID_COLS,
+	MOTION_GRID_ROWS,
+};
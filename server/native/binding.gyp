@@ -0,0 +1,12 @@
+{
+  "targets": [
+    {
+      "target_name": "shm_ring",
+      "sources": ["shm_ring.cc"],
+      "cflags_cc": ["-std=c++17", "-O2"],
+      "conditions": [
+        ["OS!='linux'", { "type": "none" }]
+      ]
+    }
+  ]
+}
@@ -0,0 +1,567 @@
+// Shared-memory frame ring for co-located camera services (Linux only).
+//
+// The server listens on a UNIX socket. Every producer that connects gets its
+// own ring: a memfd holding a control block plus fixed-size frame slots, and
+// an eventfd used as the doorbell. Both descriptors are handed over with
+// SCM_RIGHTS, after which frames never pass through the kernel again: the
+// producer writes pixels straight into a slot and rings the doorbell, and the
+// consumer thread below hands the slot to JavaScript as an external Buffer.
+//
+// Ring layout (little-endian, shared with camera_service.py):
+//
+//   control block (RING_CTRL_SIZE bytes)
+//     0   u32 magic 'SRNG'
+//     4   u32 version
+//     8   u32 slot_count
+//     12  u32 slot_size          payload capacity of one slot
+//     16  u64 head               next sequence number written by the producer
+//     64  u64 tail               next sequence number read by the consumer
+//   slot i at RING_CTRL_SIZE + i * (SLOT_HDR_SIZE + slot_size)
+//     0   u32 state              FREE -> READY (producer) -> BUSY (consumer) -> FREE
+//     4   u32 length
+//     8   u64 ts_ms
+//     16  char camNo[16]
+//     32  char filename[32]
+//     64  u32 codec              0 = BMP, otherwise raw pixels (see frameFormat.js)
+//     68  u32 width
+//     72  u32 height
+//     76  u32 stride
+//     96  payload
+//
+// A slot only returns to FREE when JavaScript calls release(), so a producer
+// that laps a slow consumer drops frames instead of overwriting live memory.
+
+#include <node_api.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#define RING_MAGIC 0x474E5253u // 'SRNG'
+#define RING_VERSION 2u
+#define RING_CTRL_SIZE 128u
+#define SLOT_HDR_SIZE 96u
+
+#define SLOT_FREE 0u
+#define SLOT_READY 1u
+#define SLOT_BUSY 2u
+
+namespace
+{
+
+  struct Ring
+  {
+    uint32_t id;
+    int memfd;
+    int eventfd;
+    int connfd; // producer control connection, HUP means the producer is gone
+    uint8_t *base;
+    size_t mapSize;
+    uint32_t slotCount;
+    uint32_t slotSize;
+    int refs;    // 1 for the live ring + 1 per outstanding external Buffer
+    bool closed; // producer disconnected, no more frames will be delivered
+  };
+
+  struct FrameEvent
+  {
+    bool isClose;
+    uint32_t ringId;
+    uint32_t slot;
+    uint8_t *data;
+    uint32_t length;
+    uint64_t tsMs;
+    char camNo[17];
+    char filename[33];
+    uint32_t format[4]; // codec, width, height, stride
+  };
+
+  struct State
+  {
+    int listenFd = -1;
+    int epollFd = -1;
+    int stopFd = -1;
+    char socketPath[108] = {0};
+    uint32_t slotCount = 0;
+    uint32_t slotSize = 0;
+    uint32_t nextRingId = 1;
+    std::mutex lock;
+    std::map<uint32_t, Ring *> rings;
+    std::thread thread;
+    napi_threadsafe_function tsfn = nullptr;
+    bool running = false;
+  };
+
+  State g_state;
+
+  inline uint32_t *slotState(Ring *ring, uint32_t slot)
+  {
+    return (uint32_t *)(ring->base + RING_CTRL_SIZE + (size_t)slot * (SLOT_HDR_SIZE + ring->slotSize));
+  }
+
+  inline uint8_t *slotHeader(Ring *ring, uint32_t slot)
+  {
+    return (uint8_t *)slotState(ring, slot);
+  }
+
+  inline uint64_t *ringTail(Ring *ring)
+  {
+    return (uint64_t *)(ring->base + 64);
+  }
+
+  // Called with g_state.lock held; frees the mapping once nothing references it
+  void unrefRingLocked(Ring *ring)
+  {
+    if (--ring->refs > 0)
+      return;
+    munmap(ring->base, ring->mapSize);
+    close(ring->memfd);
+    close(ring->eventfd);
+    if (ring->connfd >= 0)
+      close(ring->connfd);
+    g_state.rings.erase(ring->id);
+    delete ring;
+  }
+
+  Ring *createRing(void)
+  {
+    size_t mapSize = RING_CTRL_SIZE + (size_t)g_state.slotCount * (SLOT_HDR_SIZE + g_state.slotSize);
+
+    int memfd = memfd_create("surveillance-ring", MFD_CLOEXEC);
+    if (memfd < 0)
+      return nullptr;
+
+    if (ftruncate(memfd, (off_t)mapSize) != 0)
+    {
+      close(memfd);
+      return nullptr;
+    }
+
+    void *base = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (base == MAP_FAILED)
+    {
+      close(memfd);
+      return nullptr;
+    }
+
+    int efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (efd < 0)
+    {
+      munmap(base, mapSize);
+      close(memfd);
+      return nullptr;
+    }
+
+    uint8_t *ctrl = (uint8_t *)base;
+    uint32_t header[4] = {RING_MAGIC, RING_VERSION, g_state.slotCount, g_state.slotSize};
+    memcpy(ctrl, header, sizeof(header));
+
+    Ring *ring = new Ring();
+    ring->memfd = memfd;
+    ring->eventfd = efd;
+    ring->connfd = -1;
+    ring->base = (uint8_t *)base;
+    ring->mapSize = mapSize;
+    ring->slotCount = g_state.slotCount;
+    ring->slotSize = g_state.slotSize;
+    ring->refs = 1;
+    ring->closed = false;
+    return ring;
+  }
+
+  // Hand the memfd + eventfd to the producer, along with the ring geometry
+  bool sendRingFds(int connfd, Ring *ring)
+  {
+    uint32_t geometry[4] = {RING_MAGIC, RING_VERSION, ring->slotCount, ring->slotSize};
+    struct iovec iov = {geometry, sizeof(geometry)};
+
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    memset(control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    int fds[2] = {ring->memfd, ring->eventfd};
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    return sendmsg(connfd, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(geometry);
+  }
+
+  // epoll data layout: high 32 bits = kind, low 32 bits = ring id
+  enum : uint64_t
+  {
+    KIND_LISTEN = 1,
+    KIND_STOP = 2,
+    KIND_DOORBELL = 3,
+    KIND_CONN = 4
+  };
+
+  inline uint64_t epollKey(uint64_t kind, uint32_t id)
+  {
+    return (kind << 32) | id;
+  }
+
+  void acceptProducer(void)
+  {
+    int connfd = accept4(g_state.listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (connfd < 0)
+      return;
+
+    std::lock_guard<std::mutex> guard(g_state.lock);
+    Ring *ring = createRing();
+    if (!ring)
+    {
+      fprintf(stderr, "[shm_ring] ring allocation failed: %s\n", strerror(errno));
+      close(connfd);
+      return;
+    }
+
+    ring->id = g_state.nextRingId++;
+    ring->connfd = connfd;
+
+    if (!sendRingFds(connfd, ring))
+    {
+      unrefRingLocked(ring);
+      return;
+    }
+
+    g_state.rings[ring->id] = ring;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = epollKey(KIND_DOORBELL, ring->id);
+    epoll_ctl(g_state.epollFd, EPOLL_CTL_ADD, ring->eventfd, &ev);
+
+    ev.events = EPOLLRDHUP | EPOLLHUP;
+    ev.data.u64 = epollKey(KIND_CONN, ring->id);
+    epoll_ctl(g_state.epollFd, EPOLL_CTL_ADD, connfd, &ev);
+  }
+
+  void drainRing(Ring *ring)
+  {
+    uint64_t counter;
+    while (read(ring->eventfd, &counter, sizeof(counter)) == sizeof(counter))
+    {
+    }
+
+    uint64_t *tail = ringTail(ring);
+    for (;;)
+    {
+      uint32_t slot = (uint32_t)(*tail % ring->slotCount);
+      uint32_t *state = slotState(ring, slot);
+      if (__atomic_load_n(state, __ATOMIC_ACQUIRE) != SLOT_READY)
+        break;
+
+      uint8_t *hdr = slotHeader(ring, slot);
+      FrameEvent *event = new FrameEvent();
+      event->isClose = false;
+      event->ringId = ring->id;
+      event->slot = slot;
+      memcpy(&event->length, hdr + 4, sizeof(uint32_t));
+      memcpy(&event->tsMs, hdr + 8, sizeof(uint64_t));
+      memcpy(event->camNo, hdr + 16, 16);
+      event->camNo[16] = '\0';
+      memcpy(event->filename, hdr + 32, 32);
+      event->filename[32] = '\0';
+      memcpy(event->format, hdr + 64, sizeof(event->format));
+      event->data = hdr + SLOT_HDR_SIZE;
+
+      if (event->length > ring->slotSize)
+      {
+        // Corrupt slot, hand it straight back to the producer
+        delete event;
+        __atomic_store_n(state, SLOT_FREE, __ATOMIC_RELEASE);
+      }
+      else
+      {
+        __atomic_store_n(state, SLOT_BUSY, __ATOMIC_RELEASE);
+        ring->refs++;
+        napi_call_threadsafe_function(g_state.tsfn, event, napi_tsfn_blocking);
+      }
+
+      __atomic_store_n(tail, *tail + 1, __ATOMIC_RELEASE);
+    }
+  }
+
+  void consumerLoop(void)
+  {
+    struct epoll_event events[16];
+
+    for (;;)
+    {
+      int n = epoll_wait(g_state.epollFd, events, 16, -1);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        return;
+      }
+
+      for (int i = 0; i < n; i++)
+      {
+        uint64_t kind = events[i].data.u64 >> 32;
+        uint32_t id = (uint32_t)events[i].data.u64;
+
+        if (kind == KIND_STOP)
+          return;
+
+        if (kind == KIND_LISTEN)
+        {
+          acceptProducer();
+          continue;
+        }
+
+        std::lock_guard<std::mutex> guard(g_state.lock);
+        auto it = g_state.rings.find(id);
+        if (it == g_state.rings.end() || it->second->closed)
+          continue;
+        Ring *ring = it->second;
+
+        if (kind == KIND_DOORBELL)
+        {
+          drainRing(ring);
+        }
+        else if (kind == KIND_CONN)
+        {
+          // Producer went away: deliver what is left, then retire the ring
+          drainRing(ring);
+          ring->closed = true;
+          epoll_ctl(g_state.epollFd, EPOLL_CTL_DEL, ring->eventfd, nullptr);
+          epoll_ctl(g_state.epollFd, EPOLL_CTL_DEL, ring->connfd, nullptr);
+
+          FrameEvent *event = new FrameEvent();
+          memset(event, 0, sizeof(*event));
+          event->isClose = true;
+          event->ringId = ring->id;
+          napi_call_threadsafe_function(g_state.tsfn, event, napi_tsfn_blocking);
+        }
+      }
+    }
+  }
+
+  void finalizeFrameBuffer(napi_env env, void *data, void *hint)
+  {
+    (void)env;
+    (void)data;
+    uint32_t ringId = (uint32_t)(uintptr_t)hint;
+
+    std::lock_guard<std::mutex> guard(g_state.lock);
+    auto it = g_state.rings.find(ringId);
+    if (it != g_state.rings.end())
+      unrefRingLocked(it->second);
+  }
+
+  // Runs on the JS thread: onFrame(ringId, slot, buffer, camNo, tsMs, filename, codec, width, height, stride)
+  // or onFrame(ringId, -1) when a producer disconnects.
+  void callJs(napi_env env, napi_value callback, void *context, void *data)
+  {
+    (void)context;
+    FrameEvent *event = (FrameEvent *)data;
+    if (!env)
+    {
+      // Environment is going away: drop the call but still give back the ring reference it holds
+      std::lock_guard<std::mutex> guard(g_state.lock);
+      auto it = g_state.rings.find(event->ringId);
+      if (it != g_state.rings.end())
+        unrefRingLocked(it->second);
+      delete event;
+      return;
+    }
+
+    napi_value undefined;
+    napi_get_undefined(env, &undefined);
+
+    if (event->isClose)
+    {
+      napi_value argv[2];
+      napi_create_uint32(env, event->ringId, &argv[0]);
+      napi_create_int32(env, -1, &argv[1]);
+      napi_call_function(env, undefined, callback, 2, argv, nullptr);
+
+      std::lock_guard<std::mutex> guard(g_state.lock);
+      auto it = g_state.rings.find(event->ringId);
+      if (it != g_state.rings.end())
+        unrefRingLocked(it->second);
+      delete event;
+      return;
+    }
+
+    napi_value argv[10];
+    napi_create_uint32(env, event->ringId, &argv[0]);
+    napi_create_int32(env, (int32_t)event->slot, &argv[1]);
+    napi_status status = napi_create_external_buffer(env, event->length, event->data, finalizeFrameBuffer,
+                                                     (void *)(uintptr_t)event->ringId, &argv[2]);
+    if (status != napi_ok)
+    {
+      // External buffers unavailable (e.g. sandboxed runtime): fall back to one copy
+      void *copy;
+      napi_create_buffer_copy(env, event->length, event->data, &copy, &argv[2]);
+      finalizeFrameBuffer(env, nullptr, (void *)(uintptr_t)event->ringId);
+    }
+    napi_create_string_utf8(env, event->camNo, NAPI_AUTO_LENGTH, &argv[3]);
+    napi_create_double(env, (double)event->tsMs, &argv[4]);
+    napi_create_string_utf8(env, event->filename, NAPI_AUTO_LENGTH, &argv[5]);
+    for (int i = 0; i < 4; i++)
+      napi_create_uint32(env, event->format[i], &argv[6 + i]);
+    napi_call_function(env, undefined, callback, 10, argv, nullptr);
+
+    delete event;
+  }
+
+  napi_value throwError(napi_env env, const char *message)
+  {
+    napi_throw_error(env, nullptr, message);
+    return nullptr;
+  }
+
+  // listen(socketPath, slotCount, slotSize, onFrame)
+  napi_value Listen(napi_env env, napi_callback_info info)
+  {
+    size_t argc = 4;
+    napi_value argv[4];
+    napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+
+    if (g_state.running)
+      return throwError(env, "shm ring already listening");
+    if (argc < 4)
+      return throwError(env, "listen(socketPath, slotCount, slotSize, onFrame) expected");
+
+    size_t pathLen;
+    napi_get_value_string_utf8(env, argv[0], g_state.socketPath, sizeof(g_state.socketPath), &pathLen);
+    napi_get_value_uint32(env, argv[1], &g_state.slotCount);
+    napi_get_value_uint32(env, argv[2], &g_state.slotSize);
+
+    if (g_state.slotCount == 0 || g_state.slotSize == 0)
+      return throwError(env, "slotCount and slotSize must be positive");
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+      return throwError(env, strerror(errno));
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, g_state.socketPath, pathLen);
+    unlink(g_state.socketPath);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || ::listen(fd, 8) != 0)
+    {
+      int err = errno;
+      close(fd);
+      return throwError(env, strerror(err));
+    }
+
+    g_state.listenFd = fd;
+    g_state.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    g_state.stopFd = eventfd(0, EFD_CLOEXEC);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = epollKey(KIND_LISTEN, 0);
+    epoll_ctl(g_state.epollFd, EPOLL_CTL_ADD, g_state.listenFd, &ev);
+    ev.data.u64 = epollKey(KIND_STOP, 0);
+    epoll_ctl(g_state.epollFd, EPOLL_CTL_ADD, g_state.stopFd, &ev);
+
+    napi_value resourceName;
+    napi_create_string_utf8(env, "shmRing", NAPI_AUTO_LENGTH, &resourceName);
+    napi_create_threadsafe_function(env, argv[3], nullptr, resourceName, 0, 1, nullptr, nullptr, nullptr, callJs,
+                                    &g_state.tsfn);
+
+    g_state.running = true;
+    g_state.thread = std::thread(consumerLoop);
+    return nullptr;
+  }
+
+  // release(ringId, slot): hand a slot back to the producer
+  napi_value Release(napi_env env, napi_callback_info info)
+  {
+    size_t argc = 2;
+    napi_value argv[2];
+    napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr);
+
+    uint32_t ringId = 0, slot = 0;
+    napi_get_value_uint32(env, argv[0], &ringId);
+    napi_get_value_uint32(env, argv[1], &slot);
+
+    std::lock_guard<std::mutex> guard(g_state.lock);
+    auto it = g_state.rings.find(ringId);
+    if (it == g_state.rings.end() || slot >= it->second->slotCount)
+      return nullptr;
+
+    __atomic_store_n(slotState(it->second, slot), SLOT_FREE, __ATOMIC_RELEASE);
+    return nullptr;
+  }
+
+  // close(): stop accepting producers and join the consumer thread
+  napi_value Close(napi_env env, napi_callback_info info)
+  {
+    (void)info;
+    if (!g_state.running)
+      return nullptr;
+
+    uint64_t one = 1;
+    if (write(g_state.stopFd, &one, sizeof(one)) != sizeof(one))
+      return throwError(env, strerror(errno));
+    g_state.thread.join();
+
+    close(g_state.listenFd);
+    close(g_state.epollFd);
+    close(g_state.stopFd);
+    unlink(g_state.socketPath);
+
+    {
+      std::lock_guard<std::mutex> guard(g_state.lock);
+      for (auto it = g_state.rings.begin(); it != g_state.rings.end();)
+      {
+        Ring *ring = (it++)->second;
+        if (!ring->closed)
+        {
+          ring->closed = true;
+          unrefRingLocked(ring);
+        }
+      }
+    }
+
+    // Release, not abort: calls already queued are still delivered (and drop their ring references)
+    // before the function is finalized
+    napi_release_threadsafe_function(g_state.tsfn, napi_tsfn_release);
+    g_state.tsfn = nullptr;
+    g_state.running = false;
+    return nullptr;
+  }
+
+  napi_value Init(napi_env env, napi_value exports)
+  {
+    napi_property_descriptor props[] = {
+        {"listen", nullptr, Listen, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"release", nullptr, Release, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"close", nullptr, Close, nullptr, nullptr, nullptr, napi_default, nullptr},
+    };
+    napi_define_properties(env, exports, sizeof(props) / sizeof(props[0]), props);
+    return exports;
+  }
+
+} // namespace
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, Init)
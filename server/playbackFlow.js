@@ -0,0 +1,137 @@
+// Per-session playback flow control over the WebSocket send window
+//
+// Frames are only handed to the socket while its bufferedAmount is below
+// `windowBytes`; beyond that they are dropped instead of queued. Every
+// `intervalMs` the backlog decides the delivery level: a growing or
+// half-full buffer steps down one level, an (almost) empty one for
+// `upgradeAfter` intervals in a row steps back up. Levels trade resolution
+// first, then frame rate:
+//   0 full BMP, 1 half resolution, 2 quarter resolution,
+//   3-5 quarter resolution sending every 2nd / 4th / 8th frame per camera
+// Effective throughput (bytes the socket actually drained) is reported to
+// the client as { type: 'playback-flow', ... } every `reportMs`.
+
+const { downscaleBmp } = require('./frameFormat');
+
+const LEVELS = [
+	{ tier: 'full', scale: 1, every: 1 },
+	{ tier: 'half', scale: 2, every: 1 },
+	{ tier: 'quarter', scale: 4, every: 1 },
+	{ tier: 'quarter', scale: 4, every: 2 },
+	{ tier: 'quarter', scale: 4, every: 4 },
+	{ tier: 'quarter', scale: 4, every: 8 },
+];
+
+class PlaybackFlow {
+	constructor(ws, { windowBytes = 4 * 1024 * 1024, intervalMs = 1000, upgradeAfter = 3, reportMs = 2000, decisions }) {
+		this.ws = ws;
+		this.windowBytes = windowBytes;
+		this.intervalMs = intervalMs;
+		this.upgradeAfter = upgradeAfter;
+		this.reportMs = reportMs;
+		this.decisions = decisions; // { sent, decimated, windowFull, levelDown, levelUp } counter children
+
+		this.level = 0;
+		this.calm = 0;
+		this.bytesSent = 0;
+		this.frameCounts = new Map(); // camNo -> frames offered
+		this.dropped = 0;
+		this.decimated = 0;
+
+		const now = Date.now();
+		this.lastEval = now;
+		this.lastReport = now;
+		this.lastDelivered = 0;
+		this.lastBuffered = 0;
+		this.throughput = 0; // bytes/s, smoothed
+	}
+
+	get current() {
+		return LEVELS[this.level];
+	}
+
+	// Should this camera's next frame be sent at all?
+	admit(camNo) {
+		this.evaluate();
+		const n = (this.frameCounts.get(camNo) || 0) + 1;
+		this.frameCounts.set(camNo, n);
+
+		if (this.ws.bufferedAmount > this.windowBytes) {
+			this.dropped++;
+			this.decisions.windowFull.inc();
+			return false;
+		}
+		if (n % this.current.every !== 0) {
+			this.decimated++;
+			this.decisions.decimated.inc();
+			return false;
+		}
+		return true;
+	}
+
+	// Image for the current tier (BMP in, BMP out)
+	encode(bmp) {
+		const { scale } = this.current;
+		return (scale > 1 && downscaleBmp(bmp, scale)) || bmp;
+	}
+
+	sent(bytes) {
+		this.bytesSent += bytes;
+		this.decisions.sent.inc();
+	}
+
+	evaluate() {
+		const now = Date.now();
+		const dt = now - this.lastEval;
+		if (dt < this.intervalMs) return;
+		this.lastEval = now;
+
+		const buffered = this.ws.bufferedAmount;
+		const delivered = this.bytesSent - buffered;
+		const rate = ((delivered - this.lastDelivered) * 1000) / dt;
+		this.throughput = this.throughput ? 0.7 * this.throughput + 0.3 * rate : rate;
+		this.lastDelivered = delivered;
+
+		const growing = buffered - this.lastBuffered > this.windowBytes / 8;
+		this.lastBuffered = buffered;
+
+		if ((buffered > this.windowBytes / 2 || growing) && this.level < LEVELS.length - 1) {
+			this.level++;
+			this.calm = 0;
+			this.decisions.levelDown.inc();
+		} else if (buffered < this.windowBytes / 16) {
+			if (++this.calm >= this.upgradeAfter && this.level > 0) {
+				this.level--;
+				this.calm = 0;
+				this.decisions.levelUp.inc();
+			}
+		} else {
+			this.calm = 0;
+		}
+
+		if (now - this.lastReport >= this.reportMs) {
+			this.lastReport = now;
+			this.report(buffered);
+		}
+	}
+
+	report(buffered) {
+		if (this.ws.readyState !== 1) return;
+		const { tier, scale, every } = this.current;
+		this.ws.send(
+			JSON.stringify({
+				type: 'playback-flow',
+				level: this.level,
+				tier,
+				scale,
+				every,
+				throughputKbps: Math.round((this.throughput * 8) / 1000),
+				bufferedBytes: buffered,
+				dropped: this.dropped,
+				decimated: this.decimated,
+			})
+		);
+	}
+}
+
+module.exports = { PlaybackFlow, FLOW_LEVELS: LEVELS };
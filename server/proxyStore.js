@@ -0,0 +1,190 @@
+// Low-resolution proxy footage in per-camera, per-hour segments
+//
+// After a frame is on disk, a worker thread (imageWorker.js) reads it back,
+// scales it down by `scale` and JPEG-encodes it. Proxies are appended to one
+// segment per camera and hour of footage, named after the camNo prefix and
+// yyMMddhh part of the frame stem (see storedFrameName in index.js; older
+// unprefixed frames share a segment per hour), with a sidecar index:
+//   <dir>/<camNo>_<yyMMddhh>.pxy   concatenated JPEGs
+//   <dir>/<camNo>_<yyMMddhh>.pxi   records of u16 stem length, stem, u32 offset, u32 length
+// The segment is written before its index record, so an index entry always
+// points at complete bytes; a crash in between only loses that proxy. Offsets
+// are 32-bit: a segment stops taking proxies at 4 GiB (far beyond one camera-hour).
+// Indexes are loaded lazily and the most recent `maxSegments` kept in memory.
+//
+// Proxy work is best-effort: jobs go through the shedder's deferrable queue,
+// at most `queueMax` wait at once (extra frames get no proxy), and readers fall
+// back to the full-resolution frame whenever get() returns null.
+
+const path = require('path');
+const fs = require('fs').promises;
+const { log } = require('./log');
+
+const STEM_RE = /^(?:(.+)_)?(\d{8})\d{4}_\d+$/; // [<camNo>_]yyMMddhhmmss_mmm[...]
+const SEGMENT_MAX_BYTES = 0xffffffff;
+
+// Segment name of a frame stem, or null when the stem isn't a frame name
+function segmentOf(stem) {
+	const match = STEM_RE.exec(stem);
+	if (!match) return null;
+	return match[1] ? `${match[1]}_${match[2]}` : match[2];
+}
+
+function stemOf(filename) {
+	return path.basename(filename).replace(/\.[^./\\]*$/, '');
+}
+
+class ProxyStore {
+	constructor({ dir, pool, shedder, registry, scale = 4, quality = 70, queueMax = 256, maxSegments = 48 }) {
+		this.dir = dir;
+		this.pool = pool;
+		this.shedder = shedder;
+		this.scale = scale;
+		this.quality = quality;
+		this.queueMax = queueMax;
+		this.maxSegments = maxSegments;
+		this.pending = 0;
+		this.failures = 0;
+		this.segments = new Map(); // segment name -> { index: Map(stem -> [offset, length]), size, ready, writing, appending }
+
+		registry.gauge('surveillance_proxy_pending', 'Proxy encodes queued or running', [], (g) =>
+			g.labels().set(this.pending)
+		);
+		const results = registry.counter('surveillance_proxy_total', 'Proxy frames by outcome', ['result']);
+		this.results = {
+			generated: results.labels('generated'),
+			dropped: results.labels('dropped'),
+			failed: results.labels('failed'),
+			hit: results.labels('hit'),
+			miss: results.labels('miss'),
+		};
+	}
+
+	async init() {
+		await fs.mkdir(this.dir, { recursive: true });
+	}
+
+	// Queue a proxy for a frame file that is now on disk
+	submit(filename, filePath) {
+		const stem = stemOf(filename);
+		const name = segmentOf(stem);
+		if (!name) return;
+		if (this.pool.failure) {
+			// Workers could not start (logged by the pool); no proxies this run
+			this.results.failed.inc();
+			return;
+		}
+		if (this.pending >= this.queueMax) {
+			this.results.dropped.inc();
+			return;
+		}
+
+		this.pending++;
+		this.shedder
+			.deferrable(() => this.pool.run({ op: 'frameJpeg', filePath, scale: this.scale, quality: this.quality }))
+			.then((bytes) => this.append(name, stem, Buffer.from(bytes.buffer, bytes.byteOffset, bytes.length)))
+			.then(() => this.results.generated.inc())
+			.catch((err) => {
+				this.results.failed.inc();
+				// A broken encoder fails every frame: log the first and then every 100th
+				if (this.failures++ % 100 === 0) log(`[PROXY] ${stem}: ${err.message} (${this.failures} failed)`, 'WARN');
+			})
+			.finally(() => this.pending--);
+	}
+
+	segment(name) {
+		let seg = this.segments.get(name);
+		if (seg) {
+			// Most recently used last
+			this.segments.delete(name);
+			this.segments.set(name, seg);
+			return seg;
+		}
+
+		seg = { index: new Map(), size: 0, appending: 0 };
+		seg.ready = this.loadIndex(name, seg);
+		seg.writing = seg.ready;
+		this.segments.set(name, seg);
+		if (this.segments.size > this.maxSegments) {
+			// A segment with appends in flight stays: a reloaded copy would compute stale offsets
+			for (const [n, s] of this.segments) {
+				if (s.appending === 0) {
+					this.segments.delete(n);
+					break;
+				}
+			}
+		}
+		return seg;
+	}
+
+	async loadIndex(name, seg) {
+		const base = path.join(this.dir, name);
+		try {
+			seg.size = (await fs.stat(`${base}.pxy`)).size;
+			const idx = await fs.readFile(`${base}.pxi`);
+			let pos = 0;
+			while (pos + 2 <= idx.length) {
+				const len = idx.readUInt16LE(pos);
+				if (pos + 2 + len + 8 > idx.length) break; // torn tail
+				const stem = idx.toString('latin1', pos + 2, pos + 2 + len);
+				pos += 2 + len;
+				seg.index.set(stem, [idx.readUInt32LE(pos), idx.readUInt32LE(pos + 4)]);
+				pos += 8;
+			}
+		} catch (err) {
+			if (err.code !== 'ENOENT') log(`[PROXY] Index ${name}: ${err.message}`, 'WARN');
+		}
+	}
+
+	// Appends to one segment are serialized; different segments write independently
+	append(name, stem, jpeg) {
+		const seg = this.segment(name);
+		seg.appending++;
+		const write = seg.writing.then(async () => {
+			const base = path.join(this.dir, name);
+			const offset = seg.size;
+			if (offset + jpeg.length > SEGMENT_MAX_BYTES) throw new Error(`Segment ${name} is full`);
+			await fs.appendFile(`${base}.pxy`, jpeg);
+			seg.size += jpeg.length;
+
+			const record = Buffer.alloc(2 + stem.length + 8);
+			record.writeUInt16LE(stem.length, 0);
+			record.write(stem, 2, 'latin1');
+			record.writeUInt32LE(offset, 2 + stem.length);
+			record.writeUInt32LE(jpeg.length, 6 + stem.length);
+			await fs.appendFile(`${base}.pxi`, record);
+			seg.index.set(stem, [offset, jpeg.length]);
+		});
+		seg.writing = write.catch(() => {}).finally(() => seg.appending--);
+		return write;
+	}
+
+	// Proxy JPEG of a frame (file name or path), or null when there is none (yet)
+	async get(filename) {
+		const stem = stemOf(filename);
+		const name = segmentOf(stem);
+		if (!name) return null;
+
+		const seg = this.segment(name);
+		await seg.ready;
+		const entry = seg.index.get(stem);
+		if (!entry) {
+			this.results.miss.inc();
+			return null;
+		}
+
+		const [offset, length] = entry;
+		const file = await fs.open(path.join(this.dir, `${name}.pxy`), 'r');
+		try {
+			const jpeg = Buffer.alloc(length);
+			const { bytesRead } = await file.read(jpeg, 0, length, offset);
+			if (bytesRead !== length) return null;
+			this.results.hit.inc();
+			return jpeg;
+		} finally {
+			await file.close();
+		}
+	}
+}
+
+module.exports = { ProxyStore };
@@ -0,0 +1,72 @@
+// Single-flight + TTL cache for index queries
+//
+// Identical queries (same normalized key) that arrive while one is running
+// share its result instead of taking another pool connection. Finished
+// results are kept for `ttlMs`, LRU-capped at `maxEntries`. The DB batcher
+// calls invalidate() with the rows it just inserted; only entries (and
+// in-flight queries) whose `matches(camNo, date)` predicate covers one of
+// those rows are dropped, so unrelated cameras and time ranges stay cached.
+
+class QueryCache {
+	constructor({ ttlMs, maxEntries }) {
+		this.ttlMs = ttlMs;
+		this.maxEntries = maxEntries;
+		this.entries = new Map(); // key -> { rows, expires, query }
+		this.inflight = new Map(); // key -> { promise, query, stale }
+	}
+
+	// query: { key, camNo, matches }; run() performs the actual DB query.
+	// Resolves { rows, source } with source 'hit' | 'miss' | 'coalesced'.
+	async get(query, run) {
+		const { key } = query;
+
+		const cached = this.entries.get(key);
+		if (cached) {
+			this.entries.delete(key);
+			if (cached.expires > Date.now()) {
+				this.entries.set(key, cached); // most recently used last
+				return { rows: cached.rows, source: 'hit' };
+			}
+		}
+
+		const flight = this.inflight.get(key);
+		if (flight) return { rows: await flight.promise, source: 'coalesced' };
+
+		const entry = { promise: run(), query, stale: false };
+		this.inflight.set(key, entry);
+		try {
+			const rows = await entry.promise;
+			// Rows inserted while the query ran may be missing from its result: don't keep it
+			if (!entry.stale) this.store(query, rows);
+			return { rows, source: 'miss' };
+		} finally {
+			this.inflight.delete(key);
+		}
+	}
+
+	store(query, rows) {
+		this.entries.set(query.key, { rows, expires: Date.now() + this.ttlMs, query });
+		if (this.entries.size > this.maxEntries) {
+			this.entries.delete(this.entries.keys().next().value);
+		}
+	}
+
+	// rows: [{ camNo, timestamp: Date }] just inserted into tb_index. Returns entries dropped.
+	invalidate(rows) {
+		let dropped = 0;
+		for (const [key, cached] of this.entries) {
+			if (rows.some((r) => cached.query.matches(r.camNo, r.timestamp))) {
+				this.entries.delete(key);
+				dropped++;
+			}
+		}
+		for (const flight of this.inflight.values()) {
+			if (!flight.stale && rows.some((r) => flight.query.matches(r.camNo, r.timestamp))) {
+				flight.stale = true;
+			}
+		}
+		return dropped;
+	}
+}
+
+module.exports = { QueryCache };
@@ -0,0 +1,215 @@
+// Per-camera frame-count rollups (tb_rollup) for coverage timelines
+//
+// The DB batcher adds every inserted tb_index batch to minute, hour and day
+// counters in the same transaction, so the counters never drift from the
+// index: a failed batch rolls both back and is retried as a whole. Buckets
+// and first/last stamps are wall-clock milliseconds, like columnar.js: the
+// local tb_index fields read as UTC (Date.UTC(t_year, t_mon - 1, ...)).
+//
+// ensureRollupTable() creates the table on startup and, unless tb_rollup_state
+// says a complete build exists, rebuilds it from the existing index in one
+// transaction before the batcher writes anything. A crash mid-backfill leaves
+// no marker, and so does a run that wrote tb_index without rollups
+// (invalidateRollups()), so either is repaired on the next start.
+
+const GRAINS = {
+	minute: 60 * 1000,
+	hour: 60 * 60 * 1000,
+	day: 24 * 60 * 60 * 1000,
+};
+
+const ROLLUP_MAX_BUCKETS = 10000;
+
+const CREATE_SQL = `
+	CREATE TABLE IF NOT EXISTS tb_rollup (
+		camNo VARCHAR(32) NOT NULL,
+		grain ENUM('minute', 'hour', 'day') NOT NULL,
+		bucket BIGINT NOT NULL,
+		frames INT UNSIGNED NOT NULL,
+		first_ts BIGINT NOT NULL,
+		last_ts BIGINT NOT NULL,
+		PRIMARY KEY (camNo, grain, bucket)
+	)
+`;
+
+const STATE_SQL = `
+	CREATE TABLE IF NOT EXISTS tb_rollup_state (
+		id TINYINT NOT NULL PRIMARY KEY,
+		built_at BIGINT NOT NULL
+	)
+`;
+
+const ER_NO_SUCH_TABLE = 1146;
+
+const UPSERT_TAIL = `
+	ON DUPLICATE KEY UPDATE
+		frames = frames + VALUES(frames),
+		first_ts = LEAST(first_ts, VALUES(first_ts)),
+		last_ts = GREATEST(last_ts, VALUES(last_ts))
+`;
+
+// Wall-clock ms of a tb_index row, in SQL (DATETIME arithmetic, independent of the session time zone)
+const ROW_TS_SQL = `(TIMESTAMPDIFF(SECOND, '1970-01-01', MAKEDATE(t_year, 1)
+	+ INTERVAL t_mon - 1 MONTH + INTERVAL t_mday - 1 DAY
+	+ INTERVAL t_hour HOUR + INTERVAL t_min MINUTE + INTERVAL t_sec SECOND) * 1000 + t_mill)`;
+
+function wallClockMs(date) {
+	return Date.UTC(
+		date.getFullYear(),
+		date.getMonth(),
+		date.getDate(),
+		date.getHours(),
+		date.getMinutes(),
+		date.getSeconds(),
+		date.getMilliseconds()
+	);
+}
+
+function bucketOf(ts, grain) {
+	return Math.floor(ts / GRAINS[grain]) * GRAINS[grain];
+}
+
+// rows: [{ camNo, timestamp: Date }] -> { sql, params } upserting one counter per (camNo, grain, bucket)
+function rollupUpsert(rows) {
+	const counters = new Map();
+	for (const r of rows) {
+		const ts = wallClockMs(r.timestamp);
+		for (const grain of Object.keys(GRAINS)) {
+			const bucket = bucketOf(ts, grain);
+			const key = `${r.camNo}|${grain}|${bucket}`;
+			const c = counters.get(key);
+			if (c) {
+				c.frames++;
+				c.first = Math.min(c.first, ts);
+				c.last = Math.max(c.last, ts);
+			} else {
+				counters.set(key, { camNo: r.camNo, grain, bucket, frames: 1, first: ts, last: ts });
+			}
+		}
+	}
+
+	// Sorted keys lock rows in the same order in every batch: concurrent flushes can't deadlock
+	const sorted = [...counters.values()].sort(
+		(a, b) => (a.camNo < b.camNo ? -1 : a.camNo > b.camNo ? 1 : 0) || a.grain.localeCompare(b.grain) || a.bucket - b.bucket
+	);
+	const params = [];
+	for (const c of sorted) params.push(c.camNo, c.grain, c.bucket, c.frames, c.first, c.last);
+	return {
+		sql: `INSERT INTO tb_rollup (camNo, grain, bucket, frames, first_ts, last_ts)
+			VALUES ${sorted.map(() => '(?, ?, ?, ?, ?, ?)').join(', ')}
+			${UPSERT_TAIL}`,
+		params,
+	};
+}
+
+// Create tb_rollup and rebuild it from tb_index unless a completed build is recorded.
+// Resolves true if it backfilled.
+async function ensureRollupTable(conn) {
+	await conn.query(CREATE_SQL);
+	await conn.query(STATE_SQL);
+	const [built] = await conn.query('SELECT built_at FROM tb_rollup_state WHERE id = 1');
+	if (built) return false;
+
+	await conn.beginTransaction();
+	try {
+		await conn.query('DELETE FROM tb_rollup');
+		await conn.query(`
+			INSERT INTO tb_rollup (camNo, grain, bucket, frames, first_ts, last_ts)
+			SELECT camNo, 'minute', MIN(ts) DIV ${GRAINS.minute} * ${GRAINS.minute}, COUNT(*), MIN(ts), MAX(ts)
+			FROM (SELECT camNo, t_year, t_mon, t_mday, t_hour, t_min, ${ROW_TS_SQL} AS ts FROM tb_index) r
+			GROUP BY camNo, t_year, t_mon, t_mday, t_hour, t_min
+		`);
+		for (const grain of ['hour', 'day']) {
+			const size = GRAINS[grain];
+			await conn.query(`
+				INSERT INTO tb_rollup (camNo, grain, bucket, frames, first_ts, last_ts)
+				SELECT camNo, '${grain}', bucket DIV ${size} * ${size} AS b, SUM(frames), MIN(first_ts), MAX(last_ts)
+				FROM tb_rollup
+				WHERE grain = 'minute'
+				GROUP BY camNo, b
+			`);
+		}
+		await conn.query('INSERT INTO tb_rollup_state (id, built_at) VALUES (1, ?)', [Date.now()]);
+		await conn.commit();
+	} catch (err) {
+		await conn.rollback().catch(() => {});
+		throw err;
+	}
+	return true;
+}
+
+// tb_index is about to get rows without rollup counters: forget the completed build so the
+// next start rebuilds tb_rollup. A missing state table already reads as "not built".
+async function invalidateRollups(conn) {
+	try {
+		await conn.query('DELETE FROM tb_rollup_state');
+	} catch (err) {
+		if (err.errno !== ER_NO_SUCH_TABLE) throw err;
+	}
+}
+
+// Returns { camNo, grain, key, start, end, sql, params, matches } or { error }
+// Query options:
+//  - camNo (required), grain: minute | hour | day (default hour)
+//  - start & end (epoch ms)  OR  year, month[, day[, hour]]
+function buildTimelineQuery(q) {
+	if (!q.camNo) return { error: 'camNo is required' };
+	const camNo = String(q.camNo);
+	const grain = q.grain ? String(q.grain) : 'hour';
+	if (!GRAINS[grain]) return { error: 'grain must be minute, hour or day' };
+
+	let start;
+	let end; // exclusive, wall-clock ms
+	if (q.start && q.end) {
+		start = wallClockMs(new Date(Number(q.start)));
+		end = wallClockMs(new Date(Number(q.end))) + 1;
+	} else if (q.year) {
+		const year = Number(q.year);
+		const month = q.month ? Number(q.month) : null;
+		const day = q.day ? Number(q.day) : null;
+		const hour = q.hour !== undefined && q.hour !== '' ? Number(q.hour) : null;
+		if (!month) {
+			start = Date.UTC(year, 0, 1);
+			end = Date.UTC(year + 1, 0, 1);
+		} else if (!day) {
+			start = Date.UTC(year, month - 1, 1);
+			end = Date.UTC(year, month, 1);
+		} else if (hour === null) {
+			start = Date.UTC(year, month - 1, day);
+			end = start + GRAINS.day;
+		} else {
+			start = Date.UTC(year, month - 1, day, hour);
+			end = start + GRAINS.hour;
+		}
+	} else {
+		return { error: 'start & end, or year[, month[, day[, hour]]] required' };
+	}
+	if (!(end > start)) return { error: 'Empty time range' };
+
+	start = bucketOf(start, grain);
+	if ((end - start) / GRAINS[grain] > ROLLUP_MAX_BUCKETS) {
+		return { error: `Range too large for grain=${grain} (max ${ROLLUP_MAX_BUCKETS} buckets)` };
+	}
+
+	return {
+		camNo,
+		grain,
+		start,
+		end,
+		key: `${camNo}|timeline:${grain}:${start}-${end}`,
+		sql: `
+			SELECT bucket, frames, first_ts, last_ts
+			FROM tb_rollup
+			WHERE camNo = ? AND grain = ? AND bucket >= ? AND bucket < ?
+			ORDER BY bucket
+		`,
+		params: [camNo, grain, start, end],
+		matches: (rowCamNo, date) => {
+			if (rowCamNo !== camNo) return false;
+			const ts = wallClockMs(date);
+			return ts >= start && ts < end;
+		},
+	};
+}
+
+module.exports = { ensureRollupTable, invalidateRollups, rollupUpsert, buildTimelineQuery, wallClockMs, GRAINS, ROLLUP_MAX_BUCKETS };
@@ -0,0 +1,76 @@
+// Shared-memory frame transport (Camera -> Node on the same host)
+// Frames arrive in memfd-backed ring slots (see native/shm_ring.cc) and are
+// handed to the ingest path as Buffers that point straight into the ring.
+// Build the addon with: npm run build:native
+const { log } = require('./log');
+const { CODEC_BMP, checkPixelFormat } = require('./frameFormat');
+
+let addon = null;
+try {
+	addon = require('./native/build/Release/shm_ring.node');
+} catch (err) {
+	addon = null;
+}
+
+// options: { socketPath, slotCount, slotSize, onFrame({ camNo, transport, filename, timestamp, format, imageBuffer, release, receivedAt }) }
+// Returns null when the addon is not built or the platform has no memfd support.
+function startShmTransport({ socketPath, slotCount, slotSize, onFrame }) {
+	if (!addon) {
+		log('Shared-memory transport disabled (native addon not built)', 'WARN');
+		return null;
+	}
+
+	const producers = new Map(); // ringId -> frame count
+
+	try {
+		const onSlot = (ringId, slot, imageBuffer, camNo, timestamp, filename, codec, width, height, stride) => {
+			const receivedAt = Date.now();
+			if (slot < 0) {
+				log(`[SHM] Camera disconnected (ring ${ringId}, frames: ${producers.get(ringId) || 0})`);
+				producers.delete(ringId);
+				return;
+			}
+
+			if (!producers.has(ringId)) {
+				log(`[SHM] Camera ${camNo} attached (ring ${ringId})`);
+				producers.set(ringId, 0);
+			}
+			producers.set(ringId, producers.get(ringId) + 1);
+
+			let released = false;
+			const release = () => {
+				if (released) return;
+				released = true;
+				addon.release(ringId, slot);
+			};
+
+			let format = null;
+			if (codec !== CODEC_BMP) {
+				format = { codec, width, height, stride };
+				const problem = checkPixelFormat(format, imageBuffer.length);
+				if (problem) {
+					log(`[SHM] ${camNo}: ${problem} - dropping frame`, 'WARN');
+					release();
+					return;
+				}
+			}
+
+			onFrame({ camNo, transport: 'shm', filename, timestamp, format, imageBuffer, release, receivedAt });
+		};
+
+		addon.listen(socketPath, slotCount, slotSize, onSlot);
+	} catch (err) {
+		log(`Shared-memory transport error: ${err.message}`, 'ERROR');
+		return null;
+	}
+
+	log(`Shared-memory transport listening on ${socketPath} (${slotCount} x ${slotSize} bytes)`);
+
+	return {
+		close() {
+			addon.close();
+		},
+	};
+}
+
+module.exports = { startShmTransport };
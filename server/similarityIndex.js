@@ -0,0 +1,306 @@
+// Perceptual-hash similarity search across stored frames
+//
+// Each analysed frame (the motion index's luma grid, see motionIndex.js) gets
+// a 64-bit difference hash: the grid is area-averaged to 9x8 and every bit
+// says whether a cell is brighter than its right neighbour. Hashes go to
+// tb_phash (camNo, ts wall-clock ms, hash as two u32 halves) and into an
+// in-memory multi-index per camera: the hash is cut into four 16-bit
+// substrings, each with its own table substring -> frame ids. Two hashes
+// within Hamming distance d share at least one substring within distance
+// floor(d / 4), so probing every table at substring radius r finds every frame
+// within distance 4r + 3. The search widens r until the K-th best is inside
+// that bound, and past MAX_PROBE_RADIUS (or when buckets are too crowded to
+// help) it finishes with an exact linear scan.
+// Memory is about 60 bytes per frame; the index is reloaded from tb_phash on startup.
+
+const { log } = require('./log');
+const { wallClockMs } = require('./rollups');
+const { fromWallClockMs } = require('./motionIndex');
+
+const SUBSTRINGS = 4;
+const MAX_PROBE_RADIUS = 2;
+const LOAD_PAGE_SIZE = 50000;
+const LOAD_RETRIES = 5;
+const LOAD_RETRY_MS = 5000;
+
+const CREATE_SQL = `
+	CREATE TABLE IF NOT EXISTS tb_phash (
+		camNo VARCHAR(32) NOT NULL,
+		ts BIGINT NOT NULL,
+		hash_hi INT UNSIGNED NOT NULL,
+		hash_lo INT UNSIGNED NOT NULL,
+		PRIMARY KEY (camNo, ts)
+	)
+`;
+
+function popcount(v) {
+	v -= (v >>> 1) & 0x55555555;
+	v = (v & 0x33333333) + ((v >>> 2) & 0x33333333);
+	return (((v + (v >>> 4)) & 0x0f0f0f0f) * 0x01010101) >>> 24;
+}
+
+// Luma grid (cols x rows, top row first) -> { hi, lo } difference hash
+function dHash(grid, cols, rows) {
+	// Area-average to 9 x 8
+	const small = new Float64Array(72);
+	for (let y = 0; y < 8; y++) {
+		const y0 = (y * rows) / 8;
+		const y1 = ((y + 1) * rows) / 8;
+		for (let x = 0; x < 9; x++) {
+			const x0 = (x * cols) / 9;
+			const x1 = ((x + 1) * cols) / 9;
+			let sum = 0;
+			let area = 0;
+			for (let gy = Math.floor(y0); gy < y1; gy++) {
+				const wy = Math.min(gy + 1, y1) - Math.max(gy, y0);
+				for (let gx = Math.floor(x0); gx < x1; gx++) {
+					const w = wy * (Math.min(gx + 1, x1) - Math.max(gx, x0));
+					sum += grid[gy * cols + gx] * w;
+					area += w;
+				}
+			}
+			small[y * 9 + x] = sum / area;
+		}
+	}
+
+	let hi = 0;
+	let lo = 0;
+	for (let y = 0; y < 8; y++) {
+		for (let x = 0; x < 8; x++) {
+			if (small[y * 9 + x] <= small[y * 9 + x + 1]) continue;
+			const bit = y * 8 + x;
+			if (bit < 32) lo |= 1 << bit;
+			else hi |= 1 << (bit - 32);
+		}
+	}
+	return { hi: hi >>> 0, lo: lo >>> 0 };
+}
+
+function substrings(hi, lo) {
+	return [lo & 0xffff, lo >>> 16, hi & 0xffff, hi >>> 16];
+}
+
+// Every 16-bit value at exactly `r` bits from v
+function* neighbours(v, r, from = 0) {
+	if (r === 0) {
+		yield v;
+		return;
+	}
+	for (let bit = from; bit < 16; bit++) yield* neighbours(v ^ (1 << bit), r - 1, bit + 1);
+}
+
+// One camera's hashes: parallel typed arrays indexed by frame id, plus the substring tables
+class CameraHashes {
+	constructor() {
+		this.size = 0;
+		this.ts = new Float64Array(1024);
+		this.hi = new Uint32Array(1024);
+		this.lo = new Uint32Array(1024);
+		this.tables = Array.from({ length: SUBSTRINGS }, () => new Map()); // substring -> [id]
+	}
+
+	add(ts, hi, lo) {
+		if (this.size === this.ts.length) {
+			const grow = (a) => {
+				const b = new a.constructor(a.length * 2);
+				b.set(a);
+				return b;
+			};
+			this.ts = grow(this.ts);
+			this.hi = grow(this.hi);
+			this.lo = grow(this.lo);
+		}
+		const id = this.size++;
+		this.ts[id] = ts;
+		this.hi[id] = hi;
+		this.lo[id] = lo;
+		substrings(hi, lo).forEach((sub, t) => {
+			const bucket = this.tables[t].get(sub);
+			if (bucket) bucket.push(id);
+			else this.tables[t].set(sub, [id]);
+		});
+	}
+
+	distance(id, hi, lo) {
+		return popcount((this.hi[id] ^ hi) >>> 0) + popcount((this.lo[id] ^ lo) >>> 0);
+	}
+
+	// k nearest as [{ id, distance }], closest first
+	search(hi, lo, k) {
+		const top = [];
+		const offer = (id, distance) => {
+			if (top.length === k && distance >= top[k - 1].distance) return;
+			let i = top.length < k ? top.length : k - 1;
+			while (i > 0 && top[i - 1].distance > distance) {
+				top[i] = top[i - 1];
+				i--;
+			}
+			top[i] = { id, distance };
+		};
+
+		const seen = new Set();
+		const subs = substrings(hi, lo);
+		for (let r = 0; r <= MAX_PROBE_RADIUS; r++) {
+			for (let t = 0; t < SUBSTRINGS; t++) {
+				for (const v of neighbours(subs[t], r)) {
+					const bucket = this.tables[t].get(v);
+					if (!bucket) continue;
+					for (const id of bucket) {
+						if (seen.has(id)) continue;
+						seen.add(id);
+						offer(id, this.distance(id, hi, lo));
+					}
+				}
+			}
+			// Everything within 4r + 3 has been seen
+			if (top.length === Math.min(k, this.size) && top[top.length - 1].distance <= SUBSTRINGS * r + SUBSTRINGS - 1) {
+				return top;
+			}
+			// Crowded buckets: probing further costs more than a scan
+			if (seen.size > this.size / 4) break;
+		}
+
+		// Exact scan from scratch: cheaper than checking `seen` for every frame
+		top.length = 0;
+		const his = this.hi;
+		const los = this.lo;
+		for (let id = 0; id < this.size; id++) {
+			const distance = popcount((his[id] ^ hi) >>> 0) + popcount((los[id] ^ lo) >>> 0);
+			if (top.length < k || distance < top[k - 1].distance) offer(id, distance);
+		}
+		return top;
+	}
+}
+
+class SimilarityIndex {
+	constructor({ writer, reader, registry, batchSize = 500, flushMs = 2000 }) {
+		this.writer = writer;
+		this.reader = reader;
+		this.batchSize = batchSize;
+		this.flushMs = flushMs;
+		this.cameras = new Map(); // camNo -> CameraHashes
+		this.rows = []; // [camNo, ts, hi, lo] waiting for the next flush
+		this.early = new Map(); // hashes added while loading: `${camNo}|${ts}` -> row
+		this.enabled = false;
+		this.loaded = false;
+		this.flushing = false;
+		this.timer = null;
+
+		registry.gauge('surveillance_phash_frames', 'Frames in the similarity index', [], (g) =>
+			g.labels().set([...this.cameras.values()].reduce((n, c) => n + c.size, 0))
+		);
+	}
+
+	async init() {
+		await this.writer.withConnection((conn) => conn.query(CREATE_SQL));
+		this.enabled = true;
+		this.timer = setInterval(() => this.flush(), this.flushMs);
+		this.timer.unref();
+	}
+
+	// Read tb_phash into memory in keyset pages; hashes arriving meanwhile are merged in afterwards.
+	// A failed page is retried from where it stopped; past LOAD_RETRIES the index is disabled
+	// (and its memory dropped) rather than left half-loaded while `early` keeps growing.
+	async load() {
+		let last = null;
+		let count = 0;
+		let failures = 0;
+		for (;;) {
+			let page;
+			try {
+				page = await this.reader.withConnection('prefetch', (conn) =>
+					last
+						? conn.query(
+								`SELECT camNo, ts, hash_hi, hash_lo FROM tb_phash WHERE (camNo, ts) > (?, ?)
+								ORDER BY camNo, ts LIMIT ${LOAD_PAGE_SIZE}`,
+								[last.camNo, last.ts]
+						  )
+						: conn.query(`SELECT camNo, ts, hash_hi, hash_lo FROM tb_phash ORDER BY camNo, ts LIMIT ${LOAD_PAGE_SIZE}`)
+				);
+			} catch (err) {
+				if (++failures > LOAD_RETRIES) {
+					this.enabled = false;
+					this.early = null;
+					this.cameras.clear();
+					throw err;
+				}
+				log(`[PHASH] Load error (retry ${failures}/${LOAD_RETRIES}): ${err.message}`, 'WARN');
+				await new Promise((resolve) => setTimeout(resolve, LOAD_RETRY_MS));
+				continue;
+			}
+			failures = 0;
+			for (const r of page) {
+				const ts = Number(r.ts);
+				if (!this.early.has(`${r.camNo}|${ts}`)) this.camera(r.camNo).add(ts, r.hash_hi, r.hash_lo);
+			}
+			count += page.length;
+			if (page.length < LOAD_PAGE_SIZE) break;
+			last = page[page.length - 1];
+		}
+		for (const [camNo, ts, hi, lo] of this.early.values()) this.camera(camNo).add(ts, hi, lo);
+		this.early = null;
+		this.loaded = true;
+		return count;
+	}
+
+	camera(camNo) {
+		let cam = this.cameras.get(camNo);
+		if (!cam) {
+			cam = new CameraHashes();
+			this.cameras.set(camNo, cam);
+		}
+		return cam;
+	}
+
+	// One analysed frame (motion index luma grid)
+	add(camNo, timestamp, grid, cols, rows) {
+		if (!this.enabled) return;
+		const { hi, lo } = dHash(grid, cols, rows);
+		const ts = wallClockMs(timestamp);
+		const row = [camNo, ts, hi, lo];
+		if (this.loaded) this.camera(camNo).add(ts, hi, lo);
+		else this.early.set(`${camNo}|${ts}`, row);
+		this.rows.push(row);
+		if (this.rows.length >= this.batchSize) this.flush();
+	}
+
+	async flush() {
+		if (this.rows.length === 0 || this.flushing) return;
+		this.flushing = true;
+		const batch = this.rows.splice(0, this.batchSize);
+		try {
+			await this.writer.withConnection((conn) =>
+				conn.query(
+					`INSERT IGNORE INTO tb_phash (camNo, ts, hash_hi, hash_lo)
+					VALUES ${batch.map(() => '(?, ?, ?, ?)').join(', ')}`,
+					batch.flat()
+				)
+			);
+		} catch (err) {
+			log(`[PHASH] Insert error: ${err.message}`, 'ERROR');
+			this.rows = batch.concat(this.rows).slice(-this.batchSize * 20);
+		} finally {
+			this.flushing = false;
+		}
+	}
+
+	stop() {
+		clearInterval(this.timer);
+		return this.flush();
+	}
+
+	// k most similar frames to a hash, on one camera or all: [{ camNo, ts (epoch ms), distance }]
+	search({ hi, lo }, k, camNo = null) {
+		const cameras = camNo ? [camNo].filter((c) => this.cameras.has(c)) : [...this.cameras.keys()];
+		const found = [];
+		for (const c of cameras) {
+			const cam = this.cameras.get(c);
+			for (const { id, distance } of cam.search(hi, lo, k)) {
+				found.push({ camNo: c, ts: fromWallClockMs(cam.ts[id]), distance });
+			}
+		}
+		return found.sort((a, b) => a.distance - b.distance || a.ts - b.ts).slice(0, k);
+	}
+}
+
+module.exports = { SimilarityIndex, dHash };
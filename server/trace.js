@@ -0,0 +1,93 @@
+// Live-frame latency tracing
+//
+// Every live frame carries { capture, received, ingest, broadcast } epoch-ms
+// stamps in its WebSocket header; the server-side stages are recorded for
+// every frame. A sampled subset also gets an `id`, which viewers echo back
+// with their own receive/display times ({ action: 'trace-ack' }) to close
+// the loop to the glass. Stages:
+//   camera          capture -> first header byte at the server (camera pipeline + network;
+//                   spans two clocks, so it includes any camera/server clock offset)
+//   parse           header -> frame handed to ingest (body transfer + parsing)
+//   broadcast       ingest -> WebSocket send (event loop, BMP synthesis)
+//   render          viewer receive -> display (viewer clock only)
+//   deliver         broadcast -> ack, minus render (viewer network both ways)
+//   glass_to_glass  capture -> ack at the server
+
+const TRACE_BUCKETS = [0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2, 5];
+
+class FrameTracer {
+	// cameraLabels: metrics.js CameraLabels shared with the other per-camera series
+	constructor({ registry, cameraLabels, sampleRate, pendingMax = 500, keep = 200 }) {
+		this.cameraLabels = cameraLabels;
+		this.sampleRate = sampleRate;
+		this.pendingMax = pendingMax;
+		this.keep = keep;
+		this.nextId = 1;
+		this.pending = new Map(); // id -> trace, insertion ordered (oldest first)
+		this.recent = []; // completed traces, newest last
+		this.stages = registry.histogram(
+			'surveillance_trace_stage_seconds',
+			'Live frame latency by pipeline stage',
+			['camera', 'stage'],
+			TRACE_BUCKETS
+		);
+		this.cameraStages = new Map(); // camera label -> { stage: histogram child }
+	}
+
+	stagesFor(camNo) {
+		const camera = this.cameraLabels.of(camNo);
+		let s = this.cameraStages.get(camera);
+		if (!s) {
+			s = {};
+			for (const stage of ['camera', 'parse', 'broadcast', 'render', 'deliver', 'glass_to_glass']) {
+				s[stage] = this.stages.labels(camera, stage);
+			}
+			this.cameraStages.set(camera, s);
+		}
+		return s;
+	}
+
+	// Stamp a frame about to be broadcast; returns the header `trace` object
+	begin(camNo, capture, received, ingest) {
+		const trace = { capture, received, ingest, broadcast: Date.now() };
+
+		const s = this.stagesFor(camNo);
+		s.camera.observe(Math.max(0, received - capture) / 1000);
+		s.parse.observe((ingest - received) / 1000);
+		s.broadcast.observe((trace.broadcast - ingest) / 1000);
+
+		if (this.sampleRate > 0 && Math.random() < this.sampleRate) {
+			trace.id = this.nextId++;
+			this.pending.set(trace.id, { camNo, ...trace });
+			if (this.pending.size > this.pendingMax) {
+				this.pending.delete(this.pending.keys().next().value);
+			}
+		}
+		return trace;
+	}
+
+	// msg: { id, receivedAt, displayedAt } from a viewer (its own clock)
+	ack(msg, viewer) {
+		const trace = this.pending.get(msg.id);
+		if (!trace) return;
+
+		const ackAt = Date.now();
+		const render = Math.max(0, Number(msg.displayedAt) - Number(msg.receivedAt)) || 0;
+		const deliver = Math.max(0, ackAt - trace.broadcast - render);
+
+		const s = this.stagesFor(trace.camNo);
+		s.render.observe(render / 1000);
+		s.deliver.observe(deliver / 1000);
+		s.glass_to_glass.observe(Math.max(0, ackAt - trace.capture) / 1000);
+
+		// Several viewers may ack the same frame; each gets its own full trace
+		this.recent.push({ ...trace, viewer, render, deliver, ack: ackAt, glassToGlass: ackAt - trace.capture });
+		if (this.recent.length > this.keep) this.recent.shift();
+	}
+
+	traces(camNo) {
+		return camNo ? this.recent.filter((t) => t.camNo === camNo) : this.recent.slice();
+	}
+}
+
+module.exports = { FrameTracer };
@@ -0,0 +1,98 @@
+// Fixed-size worker_threads pool for CPU-heavy image work
+//
+// run(task, transferList) posts `task` to the next idle worker and resolves
+// with its reply ({ result } or { error } from the worker script). Tasks
+// wait in FIFO order while every worker is busy; `urgent` tasks (a viewer is
+// waiting) go ahead of queued background work. A worker that dies fails
+// its current task and is replaced, unless it died during startup (e.g. a
+// missing module): then it is not respawned, and once no worker is left
+// every task fails with that error.
+
+const { Worker } = require('worker_threads');
+const { log } = require('./log');
+
+const STARTUP_MS = 2000;
+
+class WorkerPool {
+	constructor(script, size) {
+		this.script = script;
+		this.size = size;
+		this.idle = [];
+		this.waiting = []; // { task, transferList, resolve, reject }
+		this.urgent = []; // same, served first
+		this.busy = new Map(); // worker -> job
+		this.workers = 0;
+		this.failure = null;
+		for (let i = 0; i < size; i++) this.spawn();
+	}
+
+	get queued() {
+		return this.urgent.length + this.waiting.length;
+	}
+
+	spawn() {
+		const worker = new Worker(this.script);
+		const spawnedAt = Date.now();
+		let lastError = null;
+		this.workers++;
+		worker.unref();
+		worker.on('message', (reply) => {
+			const job = this.busy.get(worker);
+			this.busy.delete(worker);
+			if (job) {
+				if (reply.error) job.reject(new Error(reply.error));
+				else job.resolve(reply.result);
+			}
+			this.release(worker);
+		});
+		worker.on('error', (err) => {
+			lastError = err;
+			log(`Worker error (${this.script}): ${err.message}`, 'ERROR');
+			const job = this.busy.get(worker);
+			this.busy.delete(worker);
+			if (job) job.reject(err);
+		});
+		worker.on('exit', () => {
+			this.workers--;
+			this.busy.delete(worker);
+			this.idle = this.idle.filter((w) => w !== worker);
+			if (this.closed) return;
+			if (Date.now() - spawnedAt > STARTUP_MS) return this.spawn();
+			if (this.workers > 0) return;
+			this.failure = lastError || new Error(`${this.script} exited during startup`);
+			for (const job of this.urgent.splice(0).concat(this.waiting.splice(0))) job.reject(this.failure);
+		});
+		this.release(worker);
+	}
+
+	release(worker) {
+		const job = this.urgent.shift() || this.waiting.shift();
+		if (job) {
+			this.busy.set(worker, job);
+			worker.postMessage(job.task, job.transferList);
+		} else {
+			this.idle.push(worker);
+		}
+	}
+
+	run(task, transferList = [], urgent = false) {
+		if (this.failure) return Promise.reject(this.failure);
+		return new Promise((resolve, reject) => {
+			const job = { task, transferList, resolve, reject };
+			const worker = this.idle.pop();
+			if (worker) {
+				this.busy.set(worker, job);
+				worker.postMessage(task, transferList);
+			} else {
+				(urgent ? this.urgent : this.waiting).push(job);
+			}
+		});
+	}
+
+	async close() {
+		this.closed = true;
+		await Promise.all([...this.idle, ...this.busy.keys()].map((w) => w.terminate()));
+	}
+}
+
+module.exports = { WorkerPool };